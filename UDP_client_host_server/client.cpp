@@ -9,6 +9,10 @@ Title: Assignment 2
 */
 #include "datagram.h"
 
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
 /**
  * RPC client that communicates with a server using an intermediate host service.
  */
@@ -16,6 +20,10 @@ class Client : private Socket {
 private:
     struct sockaddr_in serverAddr;  // Server address structure 
     std::string filename;           // Filename for requests 
+    bool crc;                       // True to negotiate CRC32C integrity on transfers
+
+    static const size_t BLOCK_SIZE = 512; // Payload of every DATA block but the last
+    static const int MAX_ATTEMPTS = 5;    // Sends of a packet before a put gives up
 
     /**
      * Sends a read or write request to the server based on the request number. 
@@ -29,13 +37,13 @@ private:
         if (requestNum == 10) {
             packet = {0, 5, 'i', 'n', 'v', 'a', 'l', 'i', 'd'};
         } else if (requestNum % 2 == 0) {
-            packet = Datagram::createRequest(filename, mode, true);
+            packet = Datagram::createRequest(filename, mode, true, crc);
         } else {
-            packet = Datagram::createRequest(filename, mode, false);
+            packet = Datagram::createRequest(filename, mode, false, crc);
         }
         
-        std::cout << "\nSending request #" << (requestNum + 1) << std::endl;
-        Datagram::printPacket(packet);
+        Logger::log(LogLevel::INFO, "Sending request #", requestNum + 1);
+        Logger::packet(LogLevel::DEBUG, "Request:", packet);
         // Send request to server and receive response
         bool success = rpcSend(packet, serverAddr);
         if (!success) {
@@ -45,24 +53,123 @@ private:
         std::vector<uint8_t> response;
         // Check response
         if(rpcReply(response)) {
-            std::cout << "Received response:" << std::endl;
-            Datagram::printPacket(response);
+            Logger::packet(LogLevel::DEBUG, "Received response:", response);
+            if (crc && response.size() >= 2 && response[1] == 3) {
+                verifyData(response);
+            }
         } else {
             std::cerr << "Error receiving response" << std::endl;
         }     
     }
 
+    /**
+     * Verifies the CRC32C trailer of a DATA response.
+     * @param response The data packet.
+     */
+    void verifyData(const std::vector<uint8_t>& response) {
+        if (!Datagram::verifyData(response)) {
+            std::cerr << "CRC32C mismatch on data block" << std::endl;
+            return;
+        }
+        Logger::logHex(LogLevel::DEBUG, "CRC32C verified, block CRC32C ", Datagram::readWord(response, response.size() - 4));
+    }
+
+    /**
+     * Sends a packet to a server and waits for the ACK of a block, resending on timeout.
+     * @param packet The packet to send.
+     * @param block The block number the ACK must carry.
+     * @param to The server address.
+     * @param ack Receives the ACK.
+     * @return True if the ACK arrived, false on an ERROR response or after MAX_ATTEMPTS sends.
+     */
+    bool sendUntilAcked(const std::vector<uint8_t>& packet, uint16_t block, const struct sockaddr_in& to,
+                        std::vector<uint8_t>& ack) {
+        for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++) {
+            if (!rpcSend(packet, to)) {
+                return false;
+            }
+            struct sockaddr_in from;
+            // Skip stale ACKs of earlier blocks until the one expected arrives or the wait times out
+            while (receiveFrom(ack, from, 1000) == 1) {
+                if (ack.size() >= 4 && ack[1] == 5) {
+                    Logger::packet(LogLevel::ERROR, "Server answered with an error:", ack);
+                    return false;
+                }
+                if (ack.size() >= 4 && ack[1] == 4 && static_cast<uint16_t>((ack[2] << 8) | ack[3]) == block) {
+                    return true;
+                }
+            }
+        }
+        std::cerr << "No acknowledgment for block " << block << std::endl;
+        return false;
+    }
+
 public:
     /**
      * Constructs a Client object and initializes the server address.
      * @param filename The name of the file to be requested from the server.
+     * @param crc True to negotiate CRC32C integrity on transfers.
      */
-    Client(std::string filename) : filename(filename) {
+    Client(std::string filename, bool crc = false) : filename(filename), crc(crc) {
         memset(&serverAddr, 0, sizeof(serverAddr));
         serverAddr.sin_family = AF_INET;
         serverAddr.sin_port = htons(50023);
         serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
-        std::cout << "Client initialized" << std::endl;
+        Logger::log(LogLevel::INFO, "Client initialized");
+    }
+
+    using Socket::enableCapture;
+
+    /**
+     * Writes the file to a server started with --serve, in BLOCK_SIZE DATA blocks. With CRC32C
+     * negotiated, every ACK carries the server's CRC32C of the file so far, which is compared
+     * against the CRC32C of what was sent, so the whole file is checked end to end.
+     * @param port The port the server serves on.
+     * @return True if every block was acknowledged and, with CRC32C, every file CRC32C matched.
+     * @throws std::runtime_error if the file cannot be read.
+     */
+    bool put(uint16_t port) {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Error opening file " + filename);
+        }
+        std::vector<uint8_t> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        struct sockaddr_in to = serverAddr;
+        to.sin_port = htons(port);
+
+        std::vector<uint8_t> ack;
+        if (!sendUntilAcked(Datagram::createRequest(filename, "octet", false, crc), 0, to, ack)) {
+            return false;
+        }
+        uint32_t fileCrc = 0;
+        uint16_t block = 0;
+        size_t offset = 0;
+        // The last block is shorter than BLOCK_SIZE, and empty if the file is a multiple of it
+        for (;;) {
+            size_t length = std::min(BLOCK_SIZE, contents.size() - offset);
+            std::vector<uint8_t> payload(contents.begin() + offset, contents.begin() + offset + length);
+            offset += length;
+            block++;
+            if (!sendUntilAcked(Datagram::createData(block, payload, crc), block, to, ack)) {
+                return false;
+            }
+            if (crc) {
+                fileCrc = crc32c::extend(fileCrc, payload.data(), payload.size());
+                uint32_t serverCrc;
+                if (!Datagram::ackFileCrc(ack, serverCrc) || serverCrc != fileCrc) {
+                    std::cerr << "File CRC32C mismatch after block " << block << std::endl;
+                    return false;
+                }
+            }
+            if (length < BLOCK_SIZE) {
+                break;
+            }
+        }
+        Logger::log(LogLevel::INFO, "Put complete, blocks ", block);
+        if (crc) {
+            Logger::logHex(LogLevel::INFO, "File CRC32C verified by the server ", fileCrc);
+        }
+        return true;
     }
 
     /**
@@ -78,19 +185,45 @@ public:
 /**
  * Main function to start the UDP client.
  * @param argc Argument count.
- * @param argv Argument vector, expecting a filename as an argument.
+ * @param argv Argument vector, expecting a filename and optionally a capture file, --crc and --put.
  * @return Exit status code.
  */
 int main(int argc, char* argv[]) {
     try {
-        if (argc != 2) {
-            std::cerr << "Usage: " << argv[0] << " <filename.txt>" << std::endl;
+        std::string capturePath;
+        bool crc = false;
+        bool put = false;
+        bool usage = argc < 2;
+        for (int i = 2; i < argc && !usage; i++) {
+            std::string option = argv[i];
+            if (option == "--crc") {
+                crc = true;
+            } else if (option == "--put") {
+                put = true;
+            } else if (option == "--capture" && i + 1 < argc) {
+                capturePath = argv[++i];
+            } else {
+                usage = true;
+            }
+        }
+        if (usage) {
+            std::cerr << "Usage: " << argv[0] << " <filename.txt> [--capture <file.pcap>] [--crc] [--put]" << std::endl;
             return 1;
         }
         // Get filename
         std::string filename = argv[1];
-        Client client(filename);
-        client.run();
+        Client client(filename, crc);
+        if (!capturePath.empty()) {
+            client.enableCapture(capturePath);
+        }
+        if (put) {
+            // Write the file straight to a server started with --serve
+            if (!client.put(50069)) {
+                return 1;
+            }
+        } else {
+            client.run();
+        }
     } catch (const std::exception& e) {
         std::cerr << "Client error: " << e.what() << std::endl;
         return 1;
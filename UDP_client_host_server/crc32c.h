@@ -0,0 +1,155 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_HAVE_SSE42 1
+#endif
+
+/**
+ * CRC32C (Castagnoli) checksums.
+ * The SSE4.2 crc32 instruction is used when the CPU supports it, otherwise a portable
+ * slicing-by-8 table implementation. The choice is made once, on first use.
+ */
+namespace crc32c {
+    const uint32_t POLY = 0x82F63B78; // Reflected Castagnoli polynomial
+
+    /**
+     * Slicing-by-8 lookup tables, built on first use.
+     */
+    struct Tables {
+        uint32_t t[8][256];
+
+        Tables() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t crc = i;
+                for (int k = 0; k < 8; k++) {
+                    crc = (crc >> 1) ^ (POLY & (0u - (crc & 1)));
+                }
+                t[0][i] = crc;
+            }
+            for (uint32_t i = 0; i < 256; i++) {
+                for (int s = 1; s < 8; s++) {
+                    t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xFF];
+                }
+            }
+        }
+    };
+
+    /**
+     * @return The shared slicing-by-8 tables.
+     */
+    inline const Tables& tables() {
+        static const Tables instance;
+        return instance;
+    }
+
+    /**
+     * Extends a CRC32C with more data using the portable slicing-by-8 algorithm.
+     * @param crc The CRC of the preceding data, 0 to start.
+     * @param data The data to add.
+     * @param length The number of bytes to add.
+     * @return The CRC of the preceding data followed by this data.
+     */
+    inline uint32_t extendPortable(uint32_t crc, const uint8_t* data, size_t length) {
+        const Tables& tab = tables();
+        uint32_t c = ~crc;
+        while (length >= 8) {
+            uint32_t lo;
+            uint32_t hi;
+            memcpy(&lo, data, 4);
+            memcpy(&hi, data + 4, 4);
+            lo ^= c; // Assumes a little-endian host, like the rest of the packet code
+            c = tab.t[7][lo & 0xFF] ^ tab.t[6][(lo >> 8) & 0xFF] ^ tab.t[5][(lo >> 16) & 0xFF] ^ tab.t[4][lo >> 24] ^
+                tab.t[3][hi & 0xFF] ^ tab.t[2][(hi >> 8) & 0xFF] ^ tab.t[1][(hi >> 16) & 0xFF] ^ tab.t[0][hi >> 24];
+            data += 8;
+            length -= 8;
+        }
+        while (length--) {
+            c = (c >> 8) ^ tab.t[0][(c ^ *data++) & 0xFF];
+        }
+        return ~c;
+    }
+
+#ifdef CRC32C_HAVE_SSE42
+    /**
+     * Extends a CRC32C with more data using the SSE4.2 crc32 instruction.
+     * Only call when the CPU supports SSE4.2.
+     * @param crc The CRC of the preceding data, 0 to start.
+     * @param data The data to add.
+     * @param length The number of bytes to add.
+     * @return The CRC of the preceding data followed by this data.
+     */
+    __attribute__((target("sse4.2"))) inline uint32_t extendHardware(uint32_t crc, const uint8_t* data, size_t length) {
+#if defined(__x86_64__)
+        uint64_t c = ~crc;
+        while (length >= 8) {
+            uint64_t word;
+            memcpy(&word, data, 8);
+            c = _mm_crc32_u64(c, word);
+            data += 8;
+            length -= 8;
+        }
+        uint32_t c32 = static_cast<uint32_t>(c);
+#else
+        uint32_t c32 = ~crc;
+#endif
+        while (length >= 4) {
+            uint32_t word;
+            memcpy(&word, data, 4);
+            c32 = _mm_crc32_u32(c32, word);
+            data += 4;
+            length -= 4;
+        }
+        while (length--) {
+            c32 = _mm_crc32_u8(c32, *data++);
+        }
+        return ~c32;
+    }
+#endif
+
+    using ExtendFn = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+    /**
+     * @return True if the hardware implementation is available on this CPU.
+     */
+    inline bool hardwareAvailable() {
+#ifdef CRC32C_HAVE_SSE42
+        static const bool available = __builtin_cpu_supports("sse4.2");
+        return available;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * Extends a CRC32C with more data using the fastest implementation for this CPU.
+     * @param crc The CRC of the preceding data, 0 to start.
+     * @param data The data to add.
+     * @param length The number of bytes to add.
+     * @return The CRC of the preceding data followed by this data.
+     */
+    inline uint32_t extend(uint32_t crc, const uint8_t* data, size_t length) {
+#ifdef CRC32C_HAVE_SSE42
+        static const ExtendFn impl = hardwareAvailable() ? extendHardware : extendPortable;
+#else
+        static const ExtendFn impl = extendPortable;
+#endif
+        return impl(crc, data, length);
+    }
+
+    /**
+     * Computes the CRC32C of a buffer.
+     * @param data The data to checksum.
+     * @param length The number of bytes.
+     * @return The CRC32C of the data.
+     */
+    inline uint32_t value(const uint8_t* data, size_t length) {
+        return extend(0, data, length);
+    }
+}
+#endif // CRC32C_H
@@ -0,0 +1,79 @@
+/*
+Author: Varrahan Uthayan
+Title: CRC32C microbenchmark
+*/
+#include "datagram.h"
+
+#include <random>
+
+/**
+ * Measures the throughput of a CRC32C implementation.
+ * @param name Label printed with the result.
+ * @param fn The implementation to measure.
+ * @param data The buffer to checksum.
+ * @param size The number of bytes checksummed per call.
+ */
+void benchmark(const std::string& name, crc32c::ExtendFn fn, const std::vector<uint8_t>& data, size_t size) {
+    const size_t totalBytes = 1ull << 30; // Checksum 1 GiB per measurement
+    size_t iterations = totalBytes / size;
+    volatile uint32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        sink = fn(sink, data.data(), size);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "  " << name << " " << size << " B: " << iterations * size / seconds / 1e9 << " GB/s" << std::endl;
+}
+
+/**
+ * Measures how many full-size DATA blocks per second can be built and verified with CRC32C.
+ * @param data Payload bytes for the block.
+ */
+void benchmarkPackets(const std::vector<uint8_t>& data) {
+    const size_t blocks = 1000000;
+    std::vector<uint8_t> payload(data.begin(), data.begin() + 512);
+    std::vector<uint8_t> packet = Datagram::createData(1, payload, true);
+    size_t verified = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < blocks; i++) {
+        packet[4 + (i % payload.size())] ^= 1; // Defeat hoisting by touching the payload
+        uint32_t crc = crc32c::value(packet.data(), packet.size() - 4);
+        packet[packet.size() - 4] = (crc >> 24) & 0xFF;
+        packet[packet.size() - 3] = (crc >> 16) & 0xFF;
+        packet[packet.size() - 2] = (crc >> 8) & 0xFF;
+        packet[packet.size() - 1] = crc & 0xFF;
+        verified += Datagram::verifyData(packet);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "  512 B DATA block seal + verify: " << blocks / seconds / 1e6 << " M blocks/s ("
+              << verified << " verified)" << std::endl;
+}
+
+/**
+ * Runs the CRC32C microbenchmark.
+ * @return Exit status code.
+ */
+int main() {
+    std::vector<uint8_t> data(1 << 20);
+    std::mt19937 gen(42);
+    for (uint8_t& byte : data) {
+        byte = static_cast<uint8_t>(gen());
+    }
+    // Known answer check: CRC32C("123456789") = 0xE3069283
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    if (crc32c::extendPortable(0, check, sizeof(check)) != 0xE3069283 || crc32c::value(check, sizeof(check)) != 0xE3069283) {
+        std::cerr << "CRC32C self-test failed" << std::endl;
+        return 1;
+    }
+    std::cout << "CRC32C implementation: " << (crc32c::hardwareAvailable() ? "SSE4.2" : "slicing-by-8") << std::endl;
+    for (size_t size : {64, 512, 1024, 65536, 1 << 20}) {
+#ifdef CRC32C_HAVE_SSE42
+        if (crc32c::hardwareAvailable()) {
+            benchmark("sse4.2      ", crc32c::extendHardware, data, size);
+        }
+#endif
+        benchmark("slicing-by-8", crc32c::extendPortable, data, size);
+    }
+    benchmarkPackets(data);
+    return 0;
+}
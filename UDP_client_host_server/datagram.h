@@ -6,6 +6,7 @@
 #include <string>
 #include <iostream>
 #include <cstring>
+#include <strings.h>
 #include <stdexcept>
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -17,6 +18,11 @@
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <memory>
+
+#include "crc32c.h"
+#include "logger.h"
+#include "pcap.h"
 
 /**
  * @class Datagram
@@ -24,22 +30,182 @@
  */
 class Datagram {
 public:
+    /**
+     * Request option that negotiates CRC32C integrity on DATA and ACK packets.
+     * When accepted, every DATA packet carries a CRC32C of its header and payload as a 4 byte
+     * trailer, and every ACK carries the CRC32C of all payload bytes of the file so far.
+     */
+    static constexpr const char* CRC_OPTION = "crc32c";
+
+    /**
+     * Value of the crc32c option that turns CRC32C integrity on; any other value leaves it off.
+     */
+    static constexpr const char* CRC_OPTION_VALUE = "1";
+
     /**
      * Creates a Datagram packet.
      * @param filename The name of the file to read.
      * @param mode The mode of transfer.
      * @param isRead The request type, true if read request false if write request
+     * @param crc True to request CRC32C integrity on the transfer.
      * @return A vector containing the read reqeust packet data.
      */
-    static std::vector<uint8_t> createRequest(const std::string& filename, const std::string& mode, bool isRead) {
+    static std::vector<uint8_t> createRequest(const std::string& filename, const std::string& mode, bool isRead, bool crc = false) {
         std::vector<uint8_t> packet = {0, static_cast<uint8_t>(isRead ? 1 : 2)};
         packet.insert(packet.end(), filename.begin(), filename.end());
         packet.push_back(0);  // Zero byte after filename
         packet.insert(packet.end(), mode.begin(), mode.end());
         packet.push_back(0);  // Zero byte after mode
+        if (crc) {
+            // Option name and value, each zero terminated
+            const std::string option = CRC_OPTION;
+            const std::string value = CRC_OPTION_VALUE;
+            packet.insert(packet.end(), option.begin(), option.end());
+            packet.push_back(0);
+            packet.insert(packet.end(), value.begin(), value.end());
+            packet.push_back(0);
+        }
         return packet;
     }
 
+    /**
+     * Checks whether a valid request asks for CRC32C integrity.
+     * @param packet The request packet.
+     * @return True if the request carries the crc32c option with the value CRC_OPTION_VALUE.
+     */
+    static bool requestsCrc(const std::vector<uint8_t>& packet) {
+        // Skip opcode, filename and mode, then walk the option name/value pairs
+        size_t pos = 2;
+        for (int field = 0; field < 2; field++) {
+            while (pos < packet.size() && packet[pos] != 0) pos++;
+            pos++;
+        }
+        const size_t optionLen = strlen(CRC_OPTION);
+        const size_t valueLen = strlen(CRC_OPTION_VALUE);
+        while (pos < packet.size()) {
+            size_t end = pos;
+            while (end < packet.size() && packet[end] != 0) end++;
+            bool isCrc = end - pos == optionLen && strncasecmp(reinterpret_cast<const char*>(&packet[pos]), CRC_OPTION, optionLen) == 0;
+            // The option value follows its name and must be zero terminated too
+            size_t valuePos = end + 1;
+            size_t valueEnd = valuePos;
+            while (valueEnd < packet.size() && packet[valueEnd] != 0) valueEnd++;
+            if (isCrc) {
+                return valueEnd < packet.size() && valueEnd - valuePos == valueLen &&
+                       memcmp(&packet[valuePos], CRC_OPTION_VALUE, valueLen) == 0;
+            }
+            pos = valueEnd + 1;
+        }
+        return false;
+    }
+
+    /**
+     * Creates a DATA packet, optionally protected by a CRC32C trailer.
+     * @param block The block number.
+     * @param data The block payload.
+     * @param crc True to append the CRC32C of the header and payload.
+     * @return A vector containing the data packet.
+     */
+    static std::vector<uint8_t> createData(uint16_t block, const std::vector<uint8_t>& data, bool crc) {
+        std::vector<uint8_t> packet;
+        packet.reserve(4 + data.size() + (crc ? 4 : 0));
+        packet.push_back(0);
+        packet.push_back(3);
+        packet.push_back((block >> 8) & 0xFF);
+        packet.push_back(block & 0xFF);
+        packet.insert(packet.end(), data.begin(), data.end());
+        if (crc) {
+            appendWord(packet, crc32c::value(packet.data(), packet.size()));
+        }
+        return packet;
+    }
+
+    /**
+     * Creates an ACK packet, optionally carrying the CRC32C of the file received so far.
+     * @param block The block number being acknowledged.
+     * @param crc True to append the running file CRC32C.
+     * @param fileCrc The CRC32C of every payload byte up to and including this block.
+     * @return A vector containing the ack packet.
+     */
+    static std::vector<uint8_t> createAck(uint16_t block, bool crc, uint32_t fileCrc = 0) {
+        std::vector<uint8_t> packet = {0, 4, static_cast<uint8_t>((block >> 8) & 0xFF), static_cast<uint8_t>(block & 0xFF)};
+        if (crc) {
+            appendWord(packet, fileCrc);
+        }
+        return packet;
+    }
+
+    /**
+     * Creates an ERROR packet.
+     * @param code The error code.
+     * @param message A human-readable description of the error.
+     * @return A vector containing the error packet.
+     */
+    static std::vector<uint8_t> createError(uint16_t code, const std::string& message) {
+        std::vector<uint8_t> packet = {0, 5, static_cast<uint8_t>((code >> 8) & 0xFF), static_cast<uint8_t>(code & 0xFF)};
+        packet.insert(packet.end(), message.begin(), message.end());
+        packet.push_back(0);
+        return packet;
+    }
+
+    /**
+     * Verifies the CRC32C trailer of a DATA packet created with crc enabled.
+     * @param packet The data packet.
+     * @return True if the trailer matches the header and payload.
+     */
+    static bool verifyData(const std::vector<uint8_t>& packet) {
+        if (packet.size() < 8 || packet[1] != 3) return false;
+        size_t body = packet.size() - 4;
+        return crc32c::value(packet.data(), body) == readWord(packet, body);
+    }
+
+    /**
+     * Gets the payload of a DATA packet.
+     * @param packet The data packet.
+     * @param crc True if the packet carries a CRC32C trailer.
+     * @return A vector containing the block payload.
+     */
+    static std::vector<uint8_t> dataPayload(const std::vector<uint8_t>& packet, bool crc) {
+        size_t end = packet.size() - (crc ? 4 : 0);
+        if (packet.size() < 4 || end < 4) return {};
+        return std::vector<uint8_t>(packet.begin() + 4, packet.begin() + end);
+    }
+
+    /**
+     * Gets the running file CRC32C carried by an ACK packet created with crc enabled.
+     * @param packet The ack packet.
+     * @param fileCrc Receives the file CRC32C.
+     * @return True if the packet is an ACK carrying a file CRC32C.
+     */
+    static bool ackFileCrc(const std::vector<uint8_t>& packet, uint32_t& fileCrc) {
+        if (packet.size() != 8 || packet[1] != 4) return false;
+        fileCrc = readWord(packet, 4);
+        return true;
+    }
+
+    /**
+     * Appends a 32 bit word in network byte order.
+     * @param packet The packet to append to.
+     * @param word The word to append.
+     */
+    static void appendWord(std::vector<uint8_t>& packet, uint32_t word) {
+        packet.push_back((word >> 24) & 0xFF);
+        packet.push_back((word >> 16) & 0xFF);
+        packet.push_back((word >> 8) & 0xFF);
+        packet.push_back(word & 0xFF);
+    }
+
+    /**
+     * Reads a 32 bit word in network byte order.
+     * @param packet The packet to read from.
+     * @param offset The offset of the word.
+     * @return The word.
+     */
+    static uint32_t readWord(const std::vector<uint8_t>& packet, size_t offset) {
+        return (static_cast<uint32_t>(packet[offset]) << 24) | (static_cast<uint32_t>(packet[offset + 1]) << 16) |
+               (static_cast<uint32_t>(packet[offset + 2]) << 8) | packet[offset + 3];
+    }
+
     /**
      * Creates a Data or Ack packet.
      * @param isData True if the packet is a data packet, false ack packet.
@@ -64,23 +230,14 @@ public:
     }
 
     /**
-     * Prints the packet as both raw bytes and a human-readable string.
+     * Prints the packet as both raw bytes and a human-readable string, synchronously.
+     * Hot paths log packets through Logger::packet instead.
      * @param packet The packet to print.
      */
     static void printPacket(const std::vector<uint8_t>& packet) {
-        std::cout << "Packet as bytes: ";
-        for(uint8_t byte : packet) {
-            std::cout << static_cast<int>(byte) << " ";
-        }
-        std::cout << "\nPacket as string: ";
-        for(uint8_t byte : packet) {
-            if(isprint(byte)) {
-                std::cout << static_cast<char>(byte);
-            } else {
-                std::cout << "[" << static_cast<int>(byte) << "]";
-            }
-        }
-        std::cout << std::endl;
+        std::string out;
+        Logger::formatPacket(packet.data(), packet.size(), out);
+        std::cout << out << std::flush;
     }
     
     /**
@@ -100,8 +257,12 @@ public:
         size_t secondZero = firstZero + 1;
         while(secondZero < packet.size() && packet[secondZero] != 0) secondZero++;
         if(secondZero >= packet.size()) return false;
-        // Ensure nothing after second zero
-        return secondZero == packet.size() - 1;
+        // Anything after the mode must be zero terminated option name/value pairs
+        size_t fields = 0;
+        for (size_t pos = secondZero + 1; pos < packet.size(); pos++) {
+            if (packet[pos] == 0) fields++;
+        }
+        return packet.back() == 0 && fields % 2 == 0;
     }
 };
 
@@ -112,11 +273,14 @@ class Socket {
 protected:
     int sockfd; // The socket file descriptor
     struct sockaddr_in addr; // The socket address
+    std::unique_ptr<PacketCapture> capture; // Optional packet capture, null when disabled
+    struct sockaddr_in local; // Cached local address recorded in captures, port 0 until known
 
     /**
      * Constructs a Socket and initializes the socket..
      */
     Socket() : sockfd(-1) {
+        memset(&local, 0, sizeof(local));
         sockfd = socket(AF_INET, SOCK_DGRAM, 0);
         if(sockfd < 0) {
             perror("Socket creation failed");
@@ -130,6 +294,47 @@ protected:
         }
     }
 
+    /**
+     * Records a datagram if packet capture is enabled.
+     * @param data The datagram payload.
+     * @param length The payload length.
+     * @param src The source address.
+     * @param dst The destination address.
+     */
+    void capturePacket(const uint8_t* data, size_t length, const struct sockaddr_in& src, const struct sockaddr_in& dst) {
+        if (capture) {
+            capture->record(data, length, src, dst);
+        }
+    }
+
+    /**
+     * Gets the local address a socket is bound to.
+     * @param fd The socket file descriptor.
+     * @return The local address, with an unspecified address reported as loopback.
+     */
+    static struct sockaddr_in localAddress(int fd) {
+        struct sockaddr_in local;
+        socklen_t len = sizeof(local);
+        memset(&local, 0, sizeof(local));
+        getsockname(fd, (struct sockaddr*)&local, &len);
+        if (local.sin_addr.s_addr == htonl(INADDR_ANY)) {
+            local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        }
+        return local;
+    }
+
+    /**
+     * Gets the cached local address for captures. An unbound socket only gets its port on its
+     * first send, so the address is looked up again until the port is known.
+     * @return The local address.
+     */
+    const struct sockaddr_in& captureAddress() {
+        if (local.sin_port == 0) {
+            local = localAddress(sockfd);
+        }
+        return local;
+    }
+
     /**
      * Socket destructor
      */
@@ -140,6 +345,16 @@ protected:
     }
 
 public:
+    /**
+     * Starts recording every datagram sent or received on this socket into a pcap file.
+     * @param path The pcap file to create.
+     * @throws std::runtime_error if the file cannot be created.
+     */
+    void enableCapture(const std::string& path) {
+        capture.reset(new PacketCapture(path));
+        local = localAddress(sockfd);
+    }
+
     /**
      * Binds the socket to the specified port.
      * @param port The port number to bind to.
@@ -155,39 +370,57 @@ public:
             perror("Bind failed");
             throw std::runtime_error("Error binding socket");
         }
+        local = localAddress(sockfd);
     }
 
     /**
-     * Receives a packet from the socket.
+     * Receives a packet from the socket along with its sender.
      * @param packet The received packet.
-     * @return True if a packet was received, false otherwise.
+     * @param from The address the packet was sent from.
+     * @param timeoutMs How long to wait for a packet, in milliseconds.
+     * @return 1 if a packet was received, 0 on timeout, -1 on error.
      */
-    bool rpcReply(std::vector<uint8_t>& packet){
+    int receiveFrom(std::vector<uint8_t>& packet, struct sockaddr_in& from, int timeoutMs) {
         char buf[1024];
-        struct sockaddr_in resAddr;
-        socklen_t resAddrLen = sizeof(resAddr);
+        socklen_t fromLen = sizeof(from);
         fd_set readfds;
         FD_ZERO(&readfds);
         FD_SET(sockfd, &readfds);
         // Set timeout
         struct timeval timeout;
-        timeout.tv_sec = 5;
-        timeout.tv_usec = 0;
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_usec = (timeoutMs % 1000) * 1000;
         int activity = select(sockfd + 1, &readfds, NULL, NULL, &timeout);
         if (activity == 0) {  // Timeout occurred
-            std::cerr << "Timeout: No response received within 5 seconds" << std::endl;
-            return false;
+            return 0;
         } else if (activity < 0) {
-            perror("Error during select()");
-            return false;
+            if (errno != EINTR) perror("Error during select()");
+            return -1;
         }
-        int n = recvfrom(sockfd, buf, sizeof(buf), 0, (struct sockaddr*)&resAddr, &resAddrLen);
+        int n = recvfrom(sockfd, buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromLen);
         if (n < 0) {
             perror("Error receiving response");
-            return false;
+            return -1;
         }
         packet.assign(buf, buf + n);
-        return true;
+        if (capture) {
+            capturePacket(packet.data(), packet.size(), from, captureAddress());
+        }
+        return 1;
+    }
+
+    /**
+     * Receives a packet from the socket.
+     * @param packet The received packet.
+     * @return True if a packet was received, false otherwise.
+     */
+    bool rpcReply(std::vector<uint8_t>& packet){
+        struct sockaddr_in resAddr;
+        int result = receiveFrom(packet, resAddr, 5000);
+        if (result == 0) {
+            std::cerr << "Timeout: No response received within 5 seconds" << std::endl;
+        }
+        return result == 1;
     }
 
     /**
@@ -202,6 +435,9 @@ public:
             perror("Send failed");
             return false;
         }
+        if (capture) {
+            capturePacket(packet.data(), packet.size(), captureAddress(), addr);
+        }
         return true; 
     }
 };
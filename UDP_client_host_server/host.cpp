@@ -8,6 +8,9 @@ Due Date: March 15, 2025
 Title: Assignment 4
 */
 #include "datagram.h"
+#include "impairment.h"
+
+#include <memory>
 
 /**
  * A UDP-based host that forwards packets between a client and a server.
@@ -22,45 +25,50 @@ class Host : private Socket {
     std::atomic<bool> running;       // Flag to run threads
     struct sockaddr_in clientAddr;  // Client address
     struct sockaddr_in serverAddr;      // Server address
+    struct sockaddr_in clientLocal;     // Local address of the client-facing socket, for capture
+    struct sockaddr_in serverLocal;     // Local address of the server-facing socket, for capture
+    ImpairmentConfig impairment;        // Impairment applied to forwarded packets
+    std::unique_ptr<Impairment> toServer; // Impairment stage for client packets forwarded to the server
+    std::unique_ptr<Impairment> toClient; // Impairment stage for server responses forwarded to the client
 
     /**
      * Thread to handle client communication.
      */
     void clientHandler() {
-        std::cout << "Client handler thread started" << std::endl;
+        Logger::log(LogLevel::INFO, "Client handler thread started");
         char buffer[1024];
         while (running) {
             // Wait for client packet
             socklen_t clientAddrLen = sizeof(clientAddr);
             int n = recvfrom(clientFd, buffer, sizeof(buffer), 0, (struct sockaddr*)&clientAddr, &clientAddrLen);
+            if (n < 0) continue; // Receive timeout, re-check running flag
             std::vector<uint8_t> packet(buffer, buffer + n);
-            std::cout << "Client handler: Received packet from client:" << std::endl;
-            Datagram::printPacket(packet);
-            // Add the client packet to queue
-            std::lock_guard<std::mutex> lock(mtx);
-            queue.push(packet);
-            cv.notify_all();
+            capturePacket(packet.data(), packet.size(), clientAddr, clientLocal);
+            Logger::packet(LogLevel::DEBUG, "Client handler: Received packet from client:", packet);
+            // Pass the client packet through the impairment stage on its way to the queue
+            toServer->submit(packet);
             // Send ack to client
             std::vector<uint8_t> ack = Datagram::createDataOrAck(false, {'a', 'c', 'k'});
-            sendto(clientFd, ack.data(), ack.size(), 0, (struct sockaddr*)&clientAddr, clientAddrLen);
-            std::cout << "Client handler: Sent acknowledgment to client" << std::endl;
+            sendPacket(clientFd, ack, clientAddr);
+            Logger::log(LogLevel::DEBUG, "Client handler: Sent acknowledgment to client");
         }
-        std::cout << "Client handler thread terminated" << std::endl;
+        Logger::log(LogLevel::INFO, "Client handler thread terminated");
     }
 
     /**
      * Thread to handle server communication.
      */
     void serverHandler() {
-        std::cout << "Server handler thread started" << std::endl;
+        Logger::log(LogLevel::INFO, "Server handler thread started");
         char buffer[1024];
         while (running) {
             // Wait for server request
             socklen_t serverAddrLen = sizeof(serverAddr);
             int n = recvfrom(serverFd, buffer, sizeof(buffer), 0, (struct sockaddr*)&serverAddr, &serverAddrLen);
+            if (n < 0) continue; // Receive timeout, re-check running flag
             std::vector<uint8_t> serverRequest(buffer, buffer + n);
-            std::cout << "Server handler: Received request from server:" << std::endl;
-            Datagram::printPacket(serverRequest);
+            capturePacket(serverRequest.data(), serverRequest.size(), serverAddr, serverLocal);
+            Logger::packet(LogLevel::DEBUG, "Server handler: Received request from server:", serverRequest);
             // Check for client data
             std::vector<uint8_t> clientPacket;
             bool hasClientData = false;
@@ -80,35 +88,69 @@ class Host : private Socket {
             }
             if (hasClientData) {
                 // Forward client packet to server
-                std::cout << "Server handler: Forwarding client packet to server:" << std::endl;
-                Datagram::printPacket(clientPacket);
-                sendto(serverFd, clientPacket.data(), clientPacket.size(), 0, (struct sockaddr*)&serverAddr, serverAddrLen);
+                Logger::packet(LogLevel::DEBUG, "Server handler: Forwarding client packet to server:", clientPacket);
+                sendPacket(serverFd, clientPacket, serverAddr);
                 // Wait for server response
                 n = recvfrom(serverFd, buffer, sizeof(buffer), 0, (struct sockaddr*)&serverAddr, &serverAddrLen);
+                if (n < 0) {
+                    std::cerr << "Server handler: No response from server" << std::endl;
+                    continue;
+                }
                 std::vector<uint8_t> serverResponse(buffer, buffer + n);
-                std::cout << "Server handler: Received response from server:" << std::endl;
-                Datagram::printPacket(serverResponse);
+                capturePacket(serverResponse.data(), serverResponse.size(), serverAddr, serverLocal);
+                Logger::packet(LogLevel::DEBUG, "Server handler: Received response from server:", serverResponse);
                 // Send ack to server
                 std::vector<uint8_t> ack = Datagram::createDataOrAck(false, {'a', 'c', 'k'});
-                sendto(serverFd, ack.data(), ack.size(), 0, (struct sockaddr*)&serverAddr, serverAddrLen);
-                // Forward response to client
-                sendto(clientFd, serverResponse.data(), serverResponse.size(), 0, (struct sockaddr*)&clientAddr, sizeof(clientAddr));
-                std::cout << "Server handler: Forwarded response to client" << std::endl;
+                sendPacket(serverFd, ack, serverAddr);
+                // Forward response to client through the impairment stage
+                toClient->submit(serverResponse);
+                Logger::log(LogLevel::DEBUG, "Server handler: Forwarded response to client");
             } else {
                 // Send arbitrary value if no data from client
                 std::vector<uint8_t> noData = {0, 0};
-                sendto(serverFd, noData.data(), noData.size(), 0, (struct sockaddr*)&serverAddr, serverAddrLen);
-                std::cout << "Server handler: No client data available, sent no-data response" << std::endl;
+                sendPacket(serverFd, noData, serverAddr);
+                Logger::log(LogLevel::DEBUG, "Server handler: No client data available, sent no-data response");
             }
         }
-        std::cout << "Server handler thread terminated" << std::endl;
+        Logger::log(LogLevel::INFO, "Server handler thread terminated");
+    }
+
+    /**
+     * Sends a packet on one of the host sockets and records it if capture is enabled.
+     * @param fd The socket to send on.
+     * @param packet The packet to send.
+     * @param to The destination address.
+     */
+    void sendPacket(int fd, const std::vector<uint8_t>& packet, const struct sockaddr_in& to) {
+        if (sendto(fd, packet.data(), packet.size(), 0, (struct sockaddr*)&to, sizeof(to)) >= 0) {
+            capturePacket(packet.data(), packet.size(), fd == clientFd ? clientLocal : serverLocal, to);
+        }
+    }
+
+    /**
+     * Adds a packet released by the impairment stage to the queue.
+     * @param packet The client packet to queue for the server.
+     */
+    void enqueueForServer(const std::vector<uint8_t>& packet) {
+        std::lock_guard<std::mutex> lock(mtx);
+        queue.push(packet);
+        cv.notify_all();
+    }
+
+    /**
+     * Sends a packet released by the impairment stage to the client.
+     * @param packet The server response to forward.
+     */
+    void sendToClient(const std::vector<uint8_t>& packet) {
+        sendPacket(clientFd, packet, clientAddr);
     }
 
 public:
     /**
      * Constructs Host object and initializes sockets and addresses.
+     * @param impairment Impairment applied to packets forwarded in either direction.
      */
-    Host() : Socket(), running(true) {
+    Host(const ImpairmentConfig& impairment = ImpairmentConfig()) : Socket(), running(true), impairment(impairment) {
         // Initialize client socket
         clientFd = socket(AF_INET, SOCK_DGRAM, 0);
         if (clientFd < 0) {
@@ -121,7 +163,8 @@ public:
         if (::bind(clientFd, (struct sockaddr*)&clientAddr, sizeof(clientAddr)) < 0) {
             throw std::runtime_error("Failed to bind client socket");
         }
-        std::cout << "Client socket initialized on port 50023" << std::endl;
+        clientLocal = localAddress(clientFd);
+        Logger::log(LogLevel::INFO, "Client socket initialized on port 50023");
         // Initialize server socket
         serverFd = socket(AF_INET, SOCK_DGRAM, 0);
         if (serverFd < 0) {
@@ -135,19 +178,36 @@ public:
         if (::bind(serverFd, (struct sockaddr*)&serverSocketAddr, sizeof(serverSocketAddr)) < 0) {
             throw std::runtime_error("Failed to bind server socket");
         }
-        std::cout << "Server socket initialized on port 50024" << std::endl;
+        serverLocal = localAddress(serverFd);
+        Logger::log(LogLevel::INFO, "Server socket initialized on port 50024");
+        // Bound blocking receives so the handler threads notice when the host stops
+        struct timeval recvTimeout;
+        recvTimeout.tv_sec = 1;
+        recvTimeout.tv_usec = 0;
+        setsockopt(clientFd, SOL_SOCKET, SO_RCVTIMEO, &recvTimeout, sizeof(recvTimeout));
+        setsockopt(serverFd, SOL_SOCKET, SO_RCVTIMEO, &recvTimeout, sizeof(recvTimeout));
         // Initialize server address
         memset(&serverAddr, 0, sizeof(serverAddr));
         serverAddr.sin_family = AF_INET;
         serverAddr.sin_port = htons(50069);  // Server port
         serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
-        std::cout << "Host initialized" << std::endl;
+        // Each direction draws from its own RNG stream so both stay reproducible
+        ImpairmentConfig clientBound = impairment;
+        clientBound.seed = impairment.seed + 1;
+        toServer.reset(new Impairment(impairment, [this](const std::vector<uint8_t>& packet) { enqueueForServer(packet); }));
+        toClient.reset(new Impairment(clientBound, [this](const std::vector<uint8_t>& packet) { sendToClient(packet); }));
+        Logger::log(LogLevel::INFO, "Host initialized");
     }
 
+    using Socket::enableCapture;
+
     /**
      * Host destructor
      */
     ~Host() {
+        // Stop the impairment timers before the sockets they send on are closed
+        toServer.reset();
+        toClient.reset();
         if (clientFd >= 0) {
             close(clientFd);
         }
@@ -160,7 +220,7 @@ public:
      * Runs client and server threads
      */
     void run() {
-        std::cout << "Starting host..." << std::endl;
+        Logger::log(LogLevel::INFO, "Starting host...");
         // Run server and client threads
         std::thread clientThread(&Host::clientHandler, this);
         std::thread serverThread(&Host::serverHandler, this);
@@ -170,15 +230,82 @@ public:
         // Wait for threads to complete
         clientThread.join();
         serverThread.join();
+        if (impairment.enabled()) {
+            printStats("client -> server", toServer->stats());
+            printStats("server -> client", toClient->stats());
+        }
+    }
+
+    /**
+     * Prints the counters of one impairment stage.
+     * @param direction Label for the forwarding direction.
+     * @param stats The counters to print.
+     */
+    static void printStats(const std::string& direction, const Impairment::Stats& stats) {
+        std::cout << "Impairment " << direction << ": submitted " << stats.submitted
+                  << ", dropped " << stats.dropped << ", duplicated " << stats.duplicated
+                  << ", reordered " << stats.reordered << ", delivered " << stats.delivered << std::endl;
     }
 };
 
+/**
+ * Parses the impairment and capture options from the command line.
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @param config The impairment configuration to fill in.
+ * @param capturePath Receives the pcap file to capture into, left empty if capture is off.
+ * @return True if all options were recognized, false otherwise.
+ */
+bool parseOptions(int argc, char* argv[], ImpairmentConfig& config, std::string& capturePath) {
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) return false;
+        std::string value = argv[++i];
+        if (option == "--loss") {
+            config.lossRate = std::stod(value);
+        } else if (option == "--delay") {
+            config.delayMs = std::stoul(value);
+        } else if (option == "--jitter") {
+            config.jitterMs = std::stoul(value);
+        } else if (option == "--reorder") {
+            config.reorderRate = std::stod(value);
+        } else if (option == "--reorder-delay") {
+            config.reorderDelayMs = std::stoul(value);
+        } else if (option == "--duplicate") {
+            config.duplicateRate = std::stod(value);
+        } else if (option == "--bandwidth") {
+            config.bandwidthBps = std::stoull(value);
+        } else if (option == "--seed") {
+            config.seed = std::stoull(value);
+        } else if (option == "--capture") {
+            capturePath = value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
 /**
  * Initializes and runs host
+ * @param argc Argument count.
+ * @param argv Argument vector, optionally holding impairment and capture options.
+ * @return Exit status code.
  */
-int main() {
+int main(int argc, char* argv[]) {
     try {
-        Host host;
+        ImpairmentConfig impairment;
+        std::string capturePath;
+        if (!parseOptions(argc, argv, impairment, capturePath)) {
+            std::cerr << "Usage: " << argv[0] << " [--loss <rate>] [--delay <ms>] [--jitter <ms>]"
+                      << " [--reorder <rate>] [--reorder-delay <ms>] [--duplicate <rate>]"
+                      << " [--bandwidth <bits/s>] [--seed <n>] [--capture <file.pcap>]" << std::endl;
+            return 1;
+        }
+        Host host(impairment);
+        if (!capturePath.empty()) {
+            host.enableCapture(capturePath);
+        }
         host.run();
     } catch(const std::exception& e) {
         std::cerr << "host error: " << e.what() << std::endl;
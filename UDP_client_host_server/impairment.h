@@ -0,0 +1,289 @@
+#ifndef IMPAIRMENT_H
+#define IMPAIRMENT_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Configuration for the network impairment stage.
+ * All rates are probabilities in [0, 1]; a default constructed config forwards packets untouched.
+ */
+struct ImpairmentConfig {
+    double lossRate = 0.0;        // Probability that a packet is dropped
+    uint32_t delayMs = 0;         // Fixed one-way delay in milliseconds
+    uint32_t jitterMs = 0;        // Extra delay drawn uniformly from [0, jitterMs]
+    double reorderRate = 0.0;     // Probability that a packet is held back so later packets overtake it
+    uint32_t reorderDelayMs = 10; // Extra hold time applied to reordered packets
+    double duplicateRate = 0.0;   // Probability that a packet is delivered twice
+    uint64_t bandwidthBps = 0;    // Bandwidth cap in bits per second, 0 for unlimited
+    uint64_t seed = 1;            // Seed for the impairment RNG
+
+    /**
+     * Checks whether any impairment is configured.
+     * @return True if packets need to pass through the impairment stage.
+     */
+    bool enabled() const {
+        return lossRate > 0 || delayMs > 0 || jitterMs > 0 || reorderRate > 0 ||
+               duplicateRate > 0 || bandwidthBps > 0;
+    }
+};
+
+/**
+ * @class TimerWheel
+ * Hashed timing wheel with a fixed tick, holding packets until their release tick.
+ * Deadlines further away than one revolution stay in their slot until the wheel comes round to them.
+ */
+class TimerWheel {
+private:
+    struct Entry {
+        uint64_t deadline;           // Absolute release tick
+        std::vector<uint8_t> packet; // Packet held until the deadline
+    };
+    std::vector<std::vector<Entry>> slots; // Wheel slots indexed by tick modulo size
+    uint64_t currentTick = 0;              // Last tick that has been processed
+    size_t pending = 0;                    // Number of packets held in the wheel
+
+public:
+    /**
+     * Constructs a TimerWheel.
+     * @param numSlots The number of slots in one revolution of the wheel.
+     */
+    explicit TimerWheel(size_t numSlots = 1024) : slots(numSlots) {}
+
+    /**
+     * Schedules a packet for release. Deadlines in the past are released on the next tick.
+     * @param deadline The absolute tick at which the packet is released.
+     * @param packet The packet to hold.
+     */
+    void schedule(uint64_t deadline, std::vector<uint8_t> packet) {
+        if (deadline <= currentTick) {
+            deadline = currentTick + 1;
+        }
+        slots[deadline % slots.size()].push_back({deadline, std::move(packet)});
+        pending++;
+    }
+
+    /**
+     * Advances the wheel by one tick and collects the packets that expire on it, in scheduling order.
+     * @param expired Output vector the released packets are appended to.
+     */
+    void tick(std::vector<std::vector<uint8_t>>& expired) {
+        currentTick++;
+        std::vector<Entry>& slot = slots[currentTick % slots.size()];
+        size_t kept = 0;
+        for (size_t i = 0; i < slot.size(); i++) {
+            if (slot[i].deadline <= currentTick) {
+                expired.push_back(std::move(slot[i].packet));
+                pending--;
+            } else {
+                slot[kept++] = std::move(slot[i]);
+            }
+        }
+        slot.resize(kept);
+    }
+
+    /**
+     * Moves the wheel to the given tick without processing slots. Only valid while the wheel is empty.
+     * @param tick The tick the wheel is synchronized to.
+     */
+    void resetTo(uint64_t tick) {
+        if (pending == 0 && tick > currentTick) {
+            currentTick = tick;
+        }
+    }
+
+    /**
+     * @return The last tick that has been processed.
+     */
+    uint64_t now() const { return currentTick; }
+
+    /**
+     * @return True if no packets are held in the wheel.
+     */
+    bool empty() const { return pending == 0; }
+};
+
+/**
+ * @class Impairment
+ * Emulates a lossy network link: packet loss, fixed plus jittered delay, reordering,
+ * duplication and a bandwidth cap. Every decision is drawn from a seeded RNG in submission
+ * order, so the same packet sequence and seed always receive the same treatment.
+ * Delayed packets are released by a timer thread on a 1 ms tick; packets with no delay are
+ * delivered on the submitting thread.
+ */
+class Impairment {
+public:
+    using Deliver = std::function<void(const std::vector<uint8_t>&)>;
+
+    /**
+     * Counters describing what the impairment stage did to the traffic.
+     */
+    struct Stats {
+        uint64_t submitted = 0;  // Packets handed to the stage
+        uint64_t dropped = 0;    // Packets discarded by the loss model
+        uint64_t duplicated = 0; // Extra copies created by the duplication model
+        uint64_t reordered = 0;  // Packets held back by the reorder model
+        uint64_t delivered = 0;  // Packets released to the deliver callback
+    };
+
+private:
+    ImpairmentConfig config;  // Active impairment settings
+    Deliver deliver;          // Callback that puts a packet back on the forwarding path
+    std::mt19937_64 rng;      // Seeded RNG driving every impairment decision
+    std::uniform_real_distribution<double> unit{0.0, 1.0};
+    TimerWheel wheel;         // Packets waiting for their release tick
+    double linkFreeUs = 0;    // Time at which the bandwidth-capped link becomes idle
+    Stats counters;           // Statistics, guarded by mtx
+    std::mutex mtx;           // Guards the wheel, RNG and counters
+    std::condition_variable cv; // Wakes the timer thread when the wheel becomes non-empty
+    std::atomic<bool> running;  // Flag to run the timer thread
+    std::chrono::steady_clock::time_point start; // Reference point for tick numbering
+    std::thread timerThread;    // Thread releasing packets from the wheel
+
+    /**
+     * @return The number of microseconds since the stage was created.
+     */
+    double elapsedUs() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /**
+     * Releases expired packets once per millisecond while the wheel holds packets.
+     */
+    void timerLoop() {
+        std::vector<std::vector<uint8_t>> expired;
+        while (running) {
+            uint64_t nextTick;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this]() { return !wheel.empty() || !running; });
+                if (!running) break;
+                uint64_t target = static_cast<uint64_t>(elapsedUs() / 1000.0);
+                while (wheel.now() < target && !wheel.empty()) {
+                    wheel.tick(expired);
+                }
+                wheel.resetTo(target);
+                counters.delivered += expired.size();
+                nextTick = wheel.now() + 1;
+            }
+            // Deliver outside the lock so the callback may block on the socket
+            for (const std::vector<uint8_t>& packet : expired) {
+                deliver(packet);
+            }
+            expired.clear();
+            std::this_thread::sleep_until(start + std::chrono::milliseconds(nextTick));
+        }
+    }
+
+public:
+    /**
+     * Constructs an Impairment stage and starts its timer thread.
+     * @param config The impairment settings.
+     * @param deliver Callback invoked for every packet that leaves the stage.
+     */
+    Impairment(const ImpairmentConfig& config, Deliver deliver)
+        : config(config), deliver(std::move(deliver)), rng(config.seed), running(true),
+          start(std::chrono::steady_clock::now()) {
+        timerThread = std::thread(&Impairment::timerLoop, this);
+    }
+
+    /**
+     * Stops the timer thread. Packets still held in the wheel are discarded.
+     */
+    ~Impairment() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            running = false;
+        }
+        cv.notify_all();
+        if (timerThread.joinable()) {
+            timerThread.join();
+        }
+    }
+
+    Impairment(const Impairment&) = delete;
+    Impairment& operator=(const Impairment&) = delete;
+
+    /**
+     * Passes a packet through the impairment stage.
+     * @param packet The packet to forward.
+     */
+    void submit(std::vector<uint8_t> packet) {
+        if (!config.enabled()) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                counters.submitted++;
+                counters.delivered++;
+            }
+            deliver(packet);
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        counters.submitted++;
+        // Draw every variate up front so a packet's fate depends only on the seed and its position
+        double lossDraw = unit(rng);
+        double jitterDraw = unit(rng);
+        double reorderDraw = unit(rng);
+        double duplicateDraw = unit(rng);
+        if (lossDraw < config.lossRate) {
+            counters.dropped++;
+            return;
+        }
+        double nowUs = elapsedUs();
+        double delayUs = 1000.0 * (config.delayMs + jitterDraw * config.jitterMs);
+        if (config.bandwidthBps > 0) {
+            // Serialize onto the link behind everything already queued
+            double txUs = packet.size() * 8.0 * 1e6 / static_cast<double>(config.bandwidthBps);
+            linkFreeUs = std::max(linkFreeUs, nowUs) + txUs;
+            delayUs += linkFreeUs - nowUs;
+        }
+        if (reorderDraw < config.reorderRate) {
+            delayUs += 1000.0 * config.reorderDelayMs;
+            counters.reordered++;
+        }
+        bool duplicate = duplicateDraw < config.duplicateRate;
+        if (duplicate) {
+            counters.duplicated++;
+        }
+        if (delayUs <= 0) {
+            // Nothing to wait for, so skip the wheel's minimum one tick hold and the timer thread
+            counters.delivered += duplicate ? 2 : 1;
+            lock.unlock();
+            if (duplicate) {
+                deliver(packet);
+            }
+            deliver(packet);
+            return;
+        }
+        bool wasEmpty = wheel.empty();
+        uint64_t nowTick = static_cast<uint64_t>(nowUs / 1000.0);
+        wheel.resetTo(nowTick);
+        uint64_t deadline = static_cast<uint64_t>((nowUs + delayUs) / 1000.0);
+        if (duplicate) {
+            wheel.schedule(deadline, packet);
+        }
+        wheel.schedule(deadline, std::move(packet));
+        lock.unlock();
+        if (wasEmpty) {
+            cv.notify_one();
+        }
+    }
+
+    /**
+     * @return A snapshot of the impairment counters.
+     */
+    Stats stats() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return counters;
+    }
+};
+#endif // IMPAIRMENT_H
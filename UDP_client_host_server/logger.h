@@ -0,0 +1,257 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Severity of a log record. Records above the active level are discarded at the call site.
+ */
+enum class LogLevel : uint8_t { ERROR, WARN, INFO, DEBUG };
+
+/**
+ * @class Logger
+ * Asynchronous logger for the packet hot path.
+ * A log call checks the level and, if enabled, copies a binary record (timestamp, level,
+ * pointer to a static message, optional integer and optional packet bytes) into a lock-free
+ * ring. A background thread formats the records and writes them in batches, so the caller
+ * never formats text or flushes a stream. Messages must be string literals or otherwise
+ * outlive the logger, because only their address is recorded.
+ */
+class Logger {
+public:
+    static const size_t MAX_PACKET = 1024; // Largest packet dump kept per record
+
+private:
+    struct Record {
+        uint64_t timestampNs;   // Time since the logger started
+        LogLevel level;         // Severity
+        const char* message;    // Static message text
+        bool hasValue;          // True if value is printed after the message
+        bool hexValue;          // True to print value in hexadecimal
+        int64_t value;          // Optional integer argument
+        uint16_t length;        // Number of packet bytes, 0 for no packet
+        uint8_t packet[MAX_PACKET]; // Packet bytes to dump
+    };
+
+    static std::atomic<LogLevel>& activeLevel() {
+        static std::atomic<LogLevel> level(levelFromEnvironment());
+        return level;
+    }
+
+    Ring<Record> ring;                 // Records waiting to be formatted
+    std::atomic<bool> running;         // Flag to run the writer thread
+    std::atomic<uint64_t> dropped;     // Records lost because the ring was full
+    std::chrono::steady_clock::time_point start; // Reference point for timestamps
+    std::thread writerThread;          // Thread formatting and writing records
+
+    /**
+     * Reads the initial level from the UDP_LOG_LEVEL environment variable.
+     * @return The configured level, INFO if unset or unrecognized.
+     */
+    static LogLevel levelFromEnvironment() {
+        const char* env = std::getenv("UDP_LOG_LEVEL");
+        std::string name = env ? env : "";
+        if (name == "error") return LogLevel::ERROR;
+        if (name == "warn") return LogLevel::WARN;
+        if (name == "debug") return LogLevel::DEBUG;
+        return LogLevel::INFO;
+    }
+
+    /**
+     * Formats one record.
+     * @param record The record to format.
+     * @param out The text buffer the record is appended to.
+     */
+    void format(const Record& record, std::string& out) const {
+        static const char* const names[] = {"ERROR", "WARN ", "INFO ", "DEBUG"};
+        char prefix[48];
+        snprintf(prefix, sizeof(prefix), "[%10.6f] %s ", record.timestampNs / 1e9, names[static_cast<int>(record.level)]);
+        out += prefix;
+        out += record.message;
+        if (record.hasValue && record.hexValue) {
+            char hex[24];
+            snprintf(hex, sizeof(hex), "0x%" PRIx64, static_cast<uint64_t>(record.value));
+            out += hex;
+        } else if (record.hasValue) {
+            out += std::to_string(record.value);
+        }
+        out += '\n';
+        if (record.length > 0) {
+            formatPacket(record.packet, record.length, out);
+        }
+    }
+
+    /**
+     * Formats records until the logger stops, then drains what is left.
+     */
+    void writerLoop() {
+        std::string out;
+        auto append = [this, &out](const Record& record) { format(record, out); };
+        for (;;) {
+            bool stopping = !running;
+            while (out.size() < (64 << 10) && ring.tryPopWith(append)) {}
+            uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+            if (lost > 0) {
+                out += "[" + std::to_string(lost) + " log records dropped]\n";
+            }
+            if (!out.empty()) {
+                std::cout.write(out.data(), out.size());
+                std::cout.flush();
+                out.clear();
+                continue;
+            }
+            if (stopping) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    /**
+     * Constructs the Logger and starts its writer thread.
+     */
+    Logger() : ring(4096), running(true), dropped(0), start(std::chrono::steady_clock::now()) {
+        writerThread = std::thread(&Logger::writerLoop, this);
+    }
+
+    /**
+     * Queues a record. Never blocks; the record is dropped if the ring is full.
+     */
+    void push(LogLevel level, const char* message, bool hasValue, int64_t value, const uint8_t* packet, size_t length,
+              bool hexValue = false) {
+        uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        size_t n = length < MAX_PACKET ? length : MAX_PACKET;
+        bool stored = ring.tryPushWith([&](Record& record) {
+            record.timestampNs = now;
+            record.level = level;
+            record.message = message;
+            record.hasValue = hasValue;
+            record.hexValue = hexValue;
+            record.value = value;
+            record.length = static_cast<uint16_t>(n);
+            if (n > 0) {
+                memcpy(record.packet, packet, n);
+            }
+        });
+        if (!stored) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+public:
+    /**
+     * Stops the writer thread after writing every queued record.
+     */
+    ~Logger() {
+        running = false;
+        if (writerThread.joinable()) {
+            writerThread.join();
+        }
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    /**
+     * @return The process-wide logger.
+     */
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    /**
+     * Sets the most verbose level that is recorded.
+     * @param level The new level.
+     */
+    static void setLevel(LogLevel level) {
+        activeLevel().store(level, std::memory_order_relaxed);
+    }
+
+    /**
+     * Checks whether records of a level are recorded.
+     * @param level The level to check.
+     * @return True if the level is enabled.
+     */
+    static bool enabled(LogLevel level) {
+        return level <= activeLevel().load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Logs a message.
+     * @param level The severity.
+     * @param message The static message text.
+     */
+    static void log(LogLevel level, const char* message) {
+        if (!enabled(level)) return;
+        instance().push(level, message, false, 0, nullptr, 0);
+    }
+
+    /**
+     * Logs a message followed by an integer.
+     * @param level The severity.
+     * @param message The static message text.
+     * @param value The integer printed after the message.
+     */
+    static void log(LogLevel level, const char* message, int64_t value) {
+        if (!enabled(level)) return;
+        instance().push(level, message, true, value, nullptr, 0);
+    }
+
+    /**
+     * Logs a message followed by an integer in hexadecimal, such as a checksum.
+     * @param level The severity.
+     * @param message The static message text.
+     * @param value The integer printed after the message.
+     */
+    static void logHex(LogLevel level, const char* message, uint64_t value) {
+        if (!enabled(level)) return;
+        instance().push(level, message, true, static_cast<int64_t>(value), nullptr, 0, true);
+    }
+
+    /**
+     * Logs a message followed by a dump of a packet.
+     * @param level The severity.
+     * @param message The static message text.
+     * @param packet The packet to dump.
+     */
+    static void packet(LogLevel level, const char* message, const std::vector<uint8_t>& packet) {
+        if (!enabled(level)) return;
+        instance().push(level, message, false, 0, packet.data(), packet.size());
+    }
+
+    /**
+     * Formats a packet as raw bytes and as a human-readable string.
+     * @param data The packet bytes.
+     * @param length The number of bytes.
+     * @param out The text buffer the dump is appended to.
+     */
+    static void formatPacket(const uint8_t* data, size_t length, std::string& out) {
+        out += "Packet as bytes: ";
+        for (size_t i = 0; i < length; i++) {
+            out += std::to_string(data[i]);
+            out += ' ';
+        }
+        out += "\nPacket as string: ";
+        for (size_t i = 0; i < length; i++) {
+            if (isprint(data[i])) {
+                out += static_cast<char>(data[i]);
+            } else {
+                out += '[';
+                out += std::to_string(data[i]);
+                out += ']';
+            }
+        }
+        out += '\n';
+    }
+};
+#endif // LOGGER_H
@@ -0,0 +1,279 @@
+#ifndef PCAP_H
+#define PCAP_H
+
+#include "ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+/**
+ * On-disk layout of the pcap file format.
+ * Packets are stored as LINKTYPE_RAW (bare IPv4) with a synthesized IPv4/UDP header,
+ * so captures open directly in Wireshark or tcpdump.
+ */
+namespace pcap {
+    const uint32_t MAGIC = 0xa1b2c3d4;   // Microsecond resolution, native byte order
+    const uint32_t LINKTYPE_RAW = 101;   // Raw IPv4 packets without a link-layer header
+    const size_t IP_HEADER_SIZE = 20;    // IPv4 header without options
+    const size_t UDP_HEADER_SIZE = 8;    // UDP header
+    const size_t MAX_PAYLOAD = 1024;     // Largest datagram the stack sends or receives
+
+    struct FileHeader {
+        uint32_t magic;
+        uint16_t versionMajor;
+        uint16_t versionMinor;
+        int32_t thisZone;
+        uint32_t sigFigs;
+        uint32_t snapLen;
+        uint32_t linkType;
+    };
+
+    struct RecordHeader {
+        uint32_t tsSec;
+        uint32_t tsUsec;
+        uint32_t inclLen;
+        uint32_t origLen;
+    };
+
+    /**
+     * A UDP datagram as stored in or read back from a capture.
+     */
+    struct Packet {
+        uint64_t timestampUs = 0;    // Capture time in microseconds since the epoch
+        struct sockaddr_in src;      // Source address and port
+        struct sockaddr_in dst;      // Destination address and port
+        std::vector<uint8_t> payload; // UDP payload
+    };
+}
+
+/**
+ * @class PacketCapture
+ * Records datagrams into a pcap file without blocking the calling I/O thread.
+ * Callers copy the datagram into a slot of a lock-free ring; a background writer thread
+ * drains the ring, adds the IPv4/UDP headers and writes the file. When the ring is full the
+ * datagram is counted as dropped rather than stalling the sender.
+ */
+class PacketCapture {
+private:
+    struct Slot {
+        uint64_t timestampUs;         // Capture time in microseconds since the epoch
+        struct sockaddr_in src;       // Source address and port
+        struct sockaddr_in dst;       // Destination address and port
+        uint16_t length;              // Payload length in bytes
+        uint8_t data[pcap::MAX_PAYLOAD]; // Payload bytes
+    };
+
+    FILE* file;                       // Capture file
+    Ring<Slot> ring;                  // Datagrams waiting to be written
+    std::atomic<bool> running;        // Flag to run the writer thread
+    std::atomic<uint64_t> dropped;    // Datagrams lost because the ring was full
+    std::thread writerThread;         // Thread writing the ring to disk
+
+    /**
+     * Computes the IPv4 header checksum.
+     * @param header The header with its checksum field zeroed.
+     * @return The checksum in network byte order.
+     */
+    static uint16_t ipChecksum(const uint8_t* header) {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < pcap::IP_HEADER_SIZE; i += 2) {
+            sum += (header[i] << 8) | header[i + 1];
+        }
+        while (sum >> 16) {
+            sum = (sum & 0xFFFF) + (sum >> 16);
+        }
+        return htons(static_cast<uint16_t>(~sum));
+    }
+
+    /**
+     * Writes one slot as a pcap record.
+     * @param slot The slot to write.
+     */
+    void writeSlot(const Slot& slot) {
+        uint8_t headers[pcap::IP_HEADER_SIZE + pcap::UDP_HEADER_SIZE] = {};
+        uint16_t totalLen = static_cast<uint16_t>(sizeof(headers) + slot.length);
+        uint16_t udpLen = static_cast<uint16_t>(pcap::UDP_HEADER_SIZE + slot.length);
+        // IPv4 header
+        headers[0] = 0x45; // Version 4, 5 word header
+        uint16_t netTotalLen = htons(totalLen);
+        memcpy(&headers[2], &netTotalLen, 2);
+        headers[8] = 64;   // TTL
+        headers[9] = IPPROTO_UDP;
+        memcpy(&headers[12], &slot.src.sin_addr.s_addr, 4);
+        memcpy(&headers[16], &slot.dst.sin_addr.s_addr, 4);
+        uint16_t checksum = ipChecksum(headers);
+        memcpy(&headers[10], &checksum, 2);
+        // UDP header, checksum left as zero (not computed)
+        memcpy(&headers[20], &slot.src.sin_port, 2);
+        memcpy(&headers[22], &slot.dst.sin_port, 2);
+        uint16_t netUdpLen = htons(udpLen);
+        memcpy(&headers[24], &netUdpLen, 2);
+
+        pcap::RecordHeader record;
+        record.tsSec = static_cast<uint32_t>(slot.timestampUs / 1000000);
+        record.tsUsec = static_cast<uint32_t>(slot.timestampUs % 1000000);
+        record.inclLen = totalLen;
+        record.origLen = totalLen;
+        fwrite(&record, sizeof(record), 1, file);
+        fwrite(headers, sizeof(headers), 1, file);
+        fwrite(slot.data, 1, slot.length, file);
+    }
+
+    /**
+     * Drains the ring to disk until capture stops, then writes whatever is left.
+     */
+    void writerLoop() {
+        auto write = [this](const Slot& slot) { writeSlot(slot); };
+        while (running) {
+            if (!ring.tryPopWith(write)) {
+                fflush(file);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        while (ring.tryPopWith(write)) {}
+        fflush(file);
+    }
+
+public:
+    /**
+     * Opens a capture file and starts the writer thread.
+     * @param path The pcap file to create.
+     * @param capacity The number of datagrams the ring can buffer, a power of two.
+     * @throws std::runtime_error if the file cannot be created.
+     */
+    explicit PacketCapture(const std::string& path, size_t capacity = 4096)
+        : file(fopen(path.c_str(), "wb")), ring(capacity), running(true), dropped(0) {
+        if (!file) {
+            throw std::runtime_error("Error opening capture file " + path);
+        }
+        pcap::FileHeader header = {pcap::MAGIC, 2, 4, 0, 0, 65535, pcap::LINKTYPE_RAW};
+        fwrite(&header, sizeof(header), 1, file);
+        writerThread = std::thread(&PacketCapture::writerLoop, this);
+    }
+
+    /**
+     * Stops the writer thread after flushing buffered datagrams and closes the file.
+     */
+    ~PacketCapture() {
+        running = false;
+        if (writerThread.joinable()) {
+            writerThread.join();
+        }
+        fclose(file);
+    }
+
+    PacketCapture(const PacketCapture&) = delete;
+    PacketCapture& operator=(const PacketCapture&) = delete;
+
+    /**
+     * Records a datagram. Never blocks; the datagram is dropped if the ring is full.
+     * @param data The datagram payload.
+     * @param length The payload length, truncated to the maximum payload size.
+     * @param src The source address.
+     * @param dst The destination address.
+     */
+    void record(const uint8_t* data, size_t length, const struct sockaddr_in& src, const struct sockaddr_in& dst) {
+        uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        size_t n = length < pcap::MAX_PAYLOAD ? length : pcap::MAX_PAYLOAD;
+        bool stored = ring.tryPushWith([&](Slot& slot) {
+            slot.timestampUs = now;
+            slot.src = src;
+            slot.dst = dst;
+            slot.length = static_cast<uint16_t>(n);
+            memcpy(slot.data, data, n);
+        });
+        if (!stored) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @return The number of datagrams dropped because the ring was full.
+     */
+    uint64_t droppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @class PcapReader
+ * Reads UDP datagrams back from a capture written by PacketCapture.
+ */
+class PcapReader {
+private:
+    FILE* file; // Capture file
+
+public:
+    /**
+     * Opens a capture file and validates its header.
+     * @param path The pcap file to read.
+     * @throws std::runtime_error if the file cannot be opened or is not a raw IPv4 capture.
+     */
+    explicit PcapReader(const std::string& path) : file(fopen(path.c_str(), "rb")) {
+        if (!file) {
+            throw std::runtime_error("Error opening capture file " + path);
+        }
+        pcap::FileHeader header;
+        if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != pcap::MAGIC ||
+            header.linkType != pcap::LINKTYPE_RAW) {
+            fclose(file);
+            throw std::runtime_error("Unsupported capture format in " + path);
+        }
+    }
+
+    /**
+     * Closes the capture file.
+     */
+    ~PcapReader() {
+        fclose(file);
+    }
+
+    PcapReader(const PcapReader&) = delete;
+    PcapReader& operator=(const PcapReader&) = delete;
+
+    /**
+     * Reads the next UDP datagram, skipping any non-UDP records.
+     * @param packet Receives the datagram.
+     * @return True if a datagram was read, false at the end of the file.
+     */
+    bool next(pcap::Packet& packet) {
+        pcap::RecordHeader record;
+        std::vector<uint8_t> buf;
+        while (fread(&record, sizeof(record), 1, file) == 1) {
+            buf.resize(record.inclLen);
+            if (fread(buf.data(), 1, buf.size(), file) != buf.size()) {
+                return false;
+            }
+            if (buf.size() < pcap::IP_HEADER_SIZE + pcap::UDP_HEADER_SIZE || buf[9] != IPPROTO_UDP) {
+                continue;
+            }
+            size_t ipLen = (buf[0] & 0x0F) * 4;
+            if (buf.size() < ipLen + pcap::UDP_HEADER_SIZE) {
+                continue;
+            }
+            packet.timestampUs = static_cast<uint64_t>(record.tsSec) * 1000000 + record.tsUsec;
+            memset(&packet.src, 0, sizeof(packet.src));
+            memset(&packet.dst, 0, sizeof(packet.dst));
+            packet.src.sin_family = AF_INET;
+            packet.dst.sin_family = AF_INET;
+            memcpy(&packet.src.sin_addr.s_addr, &buf[12], 4);
+            memcpy(&packet.dst.sin_addr.s_addr, &buf[16], 4);
+            memcpy(&packet.src.sin_port, &buf[ipLen], 2);
+            memcpy(&packet.dst.sin_port, &buf[ipLen + 2], 2);
+            packet.payload.assign(buf.begin() + ipLen + pcap::UDP_HEADER_SIZE, buf.end());
+            return true;
+        }
+        return false;
+    }
+};
+#endif // PCAP_H
@@ -0,0 +1,85 @@
+/*
+Author: Varrahan Uthayan
+Title: Capture replay tool
+*/
+#include "datagram.h"
+
+/**
+ * Re-injects datagrams from a pcap capture into the host or the server.
+ * Only datagrams originally addressed to the target's port are replayed, either with their
+ * original inter-arrival gaps or back to back at maximum speed.
+ */
+class Replayer : private Socket {
+private:
+    struct sockaddr_in targetAddr; // Address the capture is replayed to
+
+public:
+    /**
+     * Constructs a Replayer aimed at a local port.
+     * @param port The port to replay datagrams to.
+     */
+    Replayer(uint16_t port) {
+        memset(&targetAddr, 0, sizeof(targetAddr));
+        targetAddr.sin_family = AF_INET;
+        targetAddr.sin_port = htons(port);
+        targetAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    }
+
+    /**
+     * Replays a capture.
+     * @param path The pcap file to replay.
+     * @param maxSpeed True to send back to back, false to keep the original timing.
+     */
+    void replay(const std::string& path, bool maxSpeed) {
+        PcapReader reader(path);
+        pcap::Packet packet;
+        uint64_t firstTimestamp = 0;
+        size_t packets = 0;
+        size_t bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        while (reader.next(packet)) {
+            if (packet.dst.sin_port != targetAddr.sin_port) {
+                continue;
+            }
+            if (packets == 0) {
+                firstTimestamp = packet.timestampUs;
+            }
+            if (!maxSpeed) {
+                std::this_thread::sleep_until(start + std::chrono::microseconds(packet.timestampUs - firstTimestamp));
+            }
+            if (rpcSend(packet.payload, targetAddr)) {
+                packets++;
+                bytes += packet.payload.size();
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Replayed " << packets << " packets (" << bytes << " bytes) in " << seconds << " s";
+        if (seconds > 0) {
+            std::cout << ": " << packets / seconds << " packets/s, " << bytes * 8 / seconds / 1e6 << " Mbit/s";
+        }
+        std::cout << std::endl;
+    }
+};
+
+/**
+ * Main function to start the replay tool.
+ * @param argc Argument count.
+ * @param argv Argument vector, expecting a capture file, a target and optionally --max-speed.
+ * @return Exit status code.
+ */
+int main(int argc, char* argv[]) {
+    try {
+        bool maxSpeed = argc == 4 && std::string(argv[3]) == "--max-speed";
+        std::string target = argc >= 3 ? argv[2] : "";
+        if ((argc != 3 && !maxSpeed) || (target != "host" && target != "server")) {
+            std::cerr << "Usage: " << argv[0] << " <capture.pcap> <host|server> [--max-speed]" << std::endl;
+            return 1;
+        }
+        Replayer replayer(target == "host" ? 50023 : 50069);
+        replayer.replay(argv[1], maxSpeed);
+    } catch (const std::exception& e) {
+        std::cerr << "Replay error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+#ifndef RING_H
+#define RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+/**
+ * @class Ring
+ * Bounded lock-free queue of fixed-size slots for any number of producers and consumers.
+ * Each slot carries a sequence number that tells producers and consumers whose turn it is,
+ * so a push or pop is one compare-and-swap on the shared position plus a copy into the slot.
+ * Producers never wait: when the ring is full tryPush fails and the caller decides what to drop.
+ * @tparam T The slot type, copied or moved in and out of the ring.
+ */
+template <typename T>
+class Ring {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence; // Turn marker for the slot
+        T value;                      // Slot payload
+    };
+    // Keep the producer and consumer positions on separate cache lines
+    alignas(64) std::atomic<size_t> enqueuePos;
+    alignas(64) std::atomic<size_t> dequeuePos;
+    alignas(64) std::unique_ptr<Cell[]> cells;
+    size_t mask;
+
+public:
+    /**
+     * Constructs a Ring.
+     * @param capacity The number of slots, must be a power of two.
+     * @throws std::invalid_argument if capacity is not a power of two.
+     */
+    explicit Ring(size_t capacity) : enqueuePos(0), dequeuePos(0), cells(new Cell[capacity]), mask(capacity - 1) {
+        if (capacity < 2 || (capacity & mask) != 0) {
+            throw std::invalid_argument("Ring capacity must be a power of two");
+        }
+        for (size_t i = 0; i < capacity; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    /**
+     * Attempts to claim a slot and fill it in place, avoiding a copy of large slot types.
+     * @param fill Callable invoked with a reference to the claimed slot.
+     * @return True if the slot was filled, false if the ring is full.
+     */
+    template <typename Fill>
+    bool tryPushWith(Fill&& fill) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    fill(cell.value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Attempts to add a value to the ring.
+     * @param value The value to add.
+     * @return True if the value was added, false if the ring is full.
+     */
+    template <typename U>
+    bool tryPush(U&& value) {
+        return tryPushWith([&value](T& slot) { slot = std::forward<U>(value); });
+    }
+
+    /**
+     * Attempts to remove the oldest slot, handing it to a callable before it is released.
+     * @param consume Callable invoked with a reference to the slot.
+     * @return True if a slot was consumed, false if the ring is empty.
+     */
+    template <typename Consume>
+    bool tryPopWith(Consume&& consume) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    consume(cell.value);
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Attempts to remove the oldest value from the ring.
+     * @param value Receives the removed value.
+     * @return True if a value was removed, false if the ring is empty.
+     */
+    bool tryPop(T& value) {
+        return tryPopWith([&value](T& slot) { value = std::move(slot); });
+    }
+};
+#endif // RING_H
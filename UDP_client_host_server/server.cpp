@@ -9,13 +9,50 @@ Title: Assignment 4
 */
 #include "datagram.h"
 
+#include <chrono>
+#include <csignal>
+#include <unordered_map>
+
+/**
+ * Set by SIGINT or SIGTERM to stop a long-running server.
+ */
+static volatile std::sig_atomic_t stopRequested = 0;
+
 /**
  * A RPC server that processes requests and sends to host.
  */
 class Server : private Socket {
 private:
+    /**
+     * Per-peer state of a transfer handled by the long-running server.
+     */
+    struct Transfer {
+        bool write = false;     // True for a write request, false for a read request
+        bool crc = false;       // True if CRC32C integrity was negotiated
+        uint16_t lastBlock = 0; // Last block acknowledged
+        uint32_t fileCrc = 0;   // CRC32C of the payload received so far
+        std::chrono::steady_clock::time_point lastActivity; // Time the peer last sent a packet
+    };
+
+    /**
+     * Counters reported when the long-running server stops.
+     */
+    struct Stats {
+        uint64_t received = 0;   // Packets received
+        uint64_t requests = 0;   // RRQ and WRQ packets served
+        uint64_t blocks = 0;     // DATA packets acknowledged
+        uint64_t errors = 0;     // ERROR responses sent for malformed or unexpected packets
+        uint64_t corrupted = 0;  // DATA packets discarded because of a CRC32C mismatch
+        uint64_t expired = 0;    // Transfers dropped after the peer went quiet
+    };
+
+    static constexpr size_t BLOCK_SIZE = 512; // A shorter DATA payload ends a write transfer
+    static constexpr std::chrono::seconds TRANSFER_TIMEOUT{30}; // Idle time before a transfer is dropped
+
     bool invalid_flag = false; // flag to terminate program when true
     struct sockaddr_in hostAddr; // Host address information
+    std::unordered_map<uint64_t, Transfer> transfers; // Open transfers keyed by peer address and port
+    Stats stats; // Long-running server counters
     /**
      * Processes incoming UDP requests.
      * @param packet The received packet.
@@ -30,7 +67,14 @@ private:
         }
         // Prepare response based on request type
         std::vector<uint8_t> response;
-        if(packet[1] == 1) {  // Read request
+        if (Datagram::requestsCrc(packet)) {
+            // Client negotiated CRC32C integrity on the transfer
+            if(packet[1] == 1) {  // Read request
+                response = Datagram::createData(1, {'d', 'a', 't', 'a'}, true);
+            } else {  // Write request, nothing received yet
+                response = Datagram::createAck(0, true, 0);
+            }
+        } else if(packet[1] == 1) {  // Read request
             response = Datagram::createDataOrAck(true, {'d', 'a', 't', 'a'});
         } else {  // Write request
             response = Datagram::createDataOrAck(false, {'a', 'c', 'k'});
@@ -44,8 +88,7 @@ private:
      */
     bool sendRequest() {
         std::vector<uint8_t> requestPacket = {0, 9}; // arbitrary request number
-        std::cout << "Server sending request for data to host:" << std::endl;
-        Datagram::printPacket(requestPacket);
+        Logger::packet(LogLevel::DEBUG, "Server sending request for data to host:", requestPacket);
         // Send request to host
         if (!rpcSend(requestPacket, hostAddr)) {
             std::cerr << "Failed to send request to host" << std::endl;
@@ -57,12 +100,10 @@ private:
             std::cerr << "No response from host" << std::endl;
             return false;
         }
-        std::cout << "Received request from client to host:" << std::endl;
-        Datagram::printPacket(clientRequest);
+        Logger::packet(LogLevel::DEBUG, "Received request from client to host:", clientRequest);
         // Process request and send back to host
         std::vector<uint8_t> response = processRequest(clientRequest);
-        std::cout << "Sending response back to host:" << std::endl;
-        Datagram::printPacket(response);
+        Logger::packet(LogLevel::DEBUG, "Sending response back to host:", response);
         if (!rpcSend(response, hostAddr)) {
             std::cerr << "Failed to send response to host" << std::endl;
             return false;
@@ -73,10 +114,157 @@ private:
             std::cerr << "No acknowledgment from host" << std::endl;
             return false;
         }
-        std::cout << "Received acknowledgment from host:" << std::endl;
-        Datagram::printPacket(ack);
+        Logger::packet(LogLevel::DEBUG, "Received acknowledgment from host:", ack);
         return true;
     }  
+    /**
+     * Builds the key identifying a peer's transfer.
+     * @param peer The peer address.
+     * @return The address and port packed into one integer.
+     */
+    static uint64_t peerKey(const struct sockaddr_in& peer) {
+        return (static_cast<uint64_t>(peer.sin_addr.s_addr) << 16) | peer.sin_port;
+    }
+
+    /**
+     * Sends an ERROR response for a packet the server cannot handle.
+     * @param peer The peer that sent the packet.
+     * @param code The error code.
+     * @param message A human-readable description of the error.
+     */
+    void sendError(const struct sockaddr_in& peer, uint16_t code, const std::string& message) {
+        stats.errors++;
+        Logger::log(LogLevel::DEBUG, "Sending error response, code ", code);
+        rpcSend(Datagram::createError(code, message), peer);
+    }
+
+    /**
+     * Handles a read or write request by opening a transfer and sending its first response.
+     * @param packet The request packet.
+     * @param peer The peer that sent the request.
+     */
+    void handleRequest(const std::vector<uint8_t>& packet, const struct sockaddr_in& peer) {
+        if (!Datagram::isValidRequest(packet)) {
+            sendError(peer, 4, "Malformed request");
+            return;
+        }
+        stats.requests++;
+        Transfer& transfer = transfers[peerKey(peer)];
+        transfer = Transfer();
+        transfer.write = packet[1] == 2;
+        transfer.crc = Datagram::requestsCrc(packet);
+        transfer.lastActivity = std::chrono::steady_clock::now();
+        if (packet[1] == 1) {  // Read request, send the first block
+            rpcSend(Datagram::createData(1, {'d', 'a', 't', 'a'}, transfer.crc), peer);
+        } else {  // Write request, acknowledge block 0
+            rpcSend(Datagram::createAck(0, transfer.crc, 0), peer);
+        }
+    }
+
+    /**
+     * Handles a DATA packet of an open write transfer by acknowledging it. The transfer is closed
+     * once its final block, one shorter than BLOCK_SIZE, has been acknowledged.
+     * @param packet The data packet.
+     * @param peer The peer that sent the packet.
+     */
+    void handleData(const std::vector<uint8_t>& packet, const struct sockaddr_in& peer) {
+        auto it = transfers.find(peerKey(peer));
+        if (it == transfers.end()) {
+            sendError(peer, 5, "Unknown transfer ID");
+            return;
+        }
+        Transfer& transfer = it->second;
+        transfer.lastActivity = std::chrono::steady_clock::now();
+        if (!transfer.write) {
+            // The peer opened a read, so it should be acknowledging data rather than sending it
+            sendError(peer, 4, "Illegal TFTP operation");
+            return;
+        }
+        if (transfer.crc && !Datagram::verifyData(packet)) {
+            // Leave the block unacknowledged so the sender retransmits it
+            stats.corrupted++;
+            return;
+        }
+        uint16_t block = static_cast<uint16_t>((packet[2] << 8) | packet[3]);
+        bool finished = false;
+        if (block == static_cast<uint16_t>(transfer.lastBlock + 1)) {
+            std::vector<uint8_t> payload = Datagram::dataPayload(packet, transfer.crc);
+            transfer.fileCrc = crc32c::extend(transfer.fileCrc, payload.data(), payload.size());
+            transfer.lastBlock = block;
+            finished = payload.size() < BLOCK_SIZE;
+        }
+        stats.blocks++;
+        rpcSend(Datagram::createAck(block, transfer.crc, transfer.fileCrc), peer);
+        if (finished) {
+            transfers.erase(it);
+        }
+    }
+
+    /**
+     * Handles an ACK packet. A read transfer is complete once its single block, block 1, is
+     * acknowledged; stray or duplicate ACKs, including any sent during a write, are ignored.
+     * @param packet The ack packet.
+     * @param peer The peer that sent the packet.
+     */
+    void handleAck(const std::vector<uint8_t>& packet, const struct sockaddr_in& peer) {
+        auto it = transfers.find(peerKey(peer));
+        if (it == transfers.end() || it->second.write) {
+            return;
+        }
+        uint16_t block = static_cast<uint16_t>((packet[2] << 8) | packet[3]);
+        if (block == 1) {
+            transfers.erase(it);
+        }
+    }
+
+    /**
+     * Drops the transfers whose peer has sent nothing for TRANSFER_TIMEOUT, so peers that vanish
+     * mid-transfer do not hold their entry forever.
+     * @param now The current time.
+     */
+    void expireTransfers(std::chrono::steady_clock::time_point now) {
+        for (auto it = transfers.begin(); it != transfers.end();) {
+            if (now - it->second.lastActivity >= TRANSFER_TIMEOUT) {
+                stats.expired++;
+                it = transfers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /**
+     * Dispatches a received packet to the handler for its opcode.
+     * @param packet The received packet.
+     * @param peer The peer that sent the packet.
+     */
+    void dispatch(const std::vector<uint8_t>& packet, const struct sockaddr_in& peer) {
+        stats.received++;
+        Logger::packet(LogLevel::DEBUG, "Received packet:", packet);
+        if (packet.size() < 4 || packet[0] != 0) {
+            sendError(peer, 4, "Malformed packet");
+            return;
+        }
+        switch (packet[1]) {
+            case 1:  // RRQ
+            case 2:  // WRQ
+                handleRequest(packet, peer);
+                break;
+            case 3:  // DATA
+                handleData(packet, peer);
+                break;
+            case 4:  // ACK
+                handleAck(packet, peer);
+                break;
+            case 5:  // ERROR from the peer aborts its transfer
+                transfers.erase(peerKey(peer));
+                break;
+            default:
+                sendError(peer, 4, "Illegal TFTP operation");
+                break;
+        }
+    }
+
 public:
     /**
      * Constructs a Server instance and binds it to port 50069. 
@@ -87,17 +275,19 @@ public:
         hostAddr.sin_family = AF_INET;
         hostAddr.sin_port = htons(50024);
         hostAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
-        std::cout << "Server initialized on port 50069" << std::endl;
+        Logger::log(LogLevel::INFO, "Server initialized on port 50069");
     }
 
+    using Socket::enableCapture;
+
     /**
      * Runs the server in an loop until invalid flag is rasied or 11 cycles are completed.
      */
     void run() {
-        std::cout << "Server running" << std::endl;
+        Logger::log(LogLevel::INFO, "Server running");
         int count = 0;
         while(true) {
-            std::cout << "\nRequest cycle #" << (count + 1) << std::endl;
+            Logger::log(LogLevel::INFO, "Request cycle #", count + 1);
             if(invalid_flag || count >= 11) {
                 std::cerr << "Invalid packet received. Terminating server" << std::endl;
                 return;
@@ -109,15 +299,77 @@ public:
             std::this_thread::sleep_for(std::chrono::milliseconds(200));
         }
     }
+
+    /**
+     * Runs the server as a long-running service. Packets are received directly from peers and
+     * dispatched by opcode until SIGINT or SIGTERM; malformed packets get an ERROR response
+     * instead of stopping the server.
+     */
+    void serve() {
+        Logger::log(LogLevel::INFO, "Server serving requests on port 50069");
+        std::vector<uint8_t> packet;
+        struct sockaddr_in peer;
+        auto nextExpiry = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (!stopRequested) {
+            // Short timeout so a stop request is noticed promptly
+            if (receiveFrom(packet, peer, 500) == 1) {
+                dispatch(packet, peer);
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now >= nextExpiry) {
+                expireTransfers(now);
+                nextExpiry = now + std::chrono::seconds(1);
+            }
+        }
+        std::cout << "Server stopped: received " << stats.received << ", requests " << stats.requests
+                  << ", blocks " << stats.blocks << ", errors " << stats.errors
+                  << ", corrupted " << stats.corrupted << ", expired " << stats.expired << std::endl;
+    }
 };
 
+/**
+ * Requests a long-running server to stop.
+ */
+void handleStopSignal(int) {
+    stopRequested = 1;
+}
+
 /**
  * Initializes and runs the server.
+ * @param argc Argument count.
+ * @param argv Argument vector, optionally holding --serve and a capture file.
+ * @return Exit status code.
  */
-int main() {
+int main(int argc, char* argv[]) {
     try {
+        std::string capturePath;
+        bool serve = false;
+        bool usage = false;
+        for (int i = 1; i < argc && !usage; i++) {
+            std::string option = argv[i];
+            if (option == "--serve") {
+                serve = true;
+            } else if (option == "--capture" && i + 1 < argc) {
+                capturePath = argv[++i];
+            } else {
+                usage = true;
+            }
+        }
+        if (usage) {
+            std::cerr << "Usage: " << argv[0] << " [--serve] [--capture <file.pcap>]" << std::endl;
+            return 1;
+        }
         Server server;
-        server.run();
+        if (!capturePath.empty()) {
+            server.enableCapture(capturePath);
+        }
+        if (serve) {
+            std::signal(SIGINT, handleStopSignal);
+            std::signal(SIGTERM, handleStopSignal);
+            server.serve();
+        } else {
+            server.run();
+        }
     } catch(const std::exception& e) {
         std::cerr << "Server error: " << e.what() << std::endl;
         return 1;
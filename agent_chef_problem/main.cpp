@@ -7,9 +7,14 @@ Lab Section: SYSC3303B1
 Due Date: January 25, 2025
 Title: Assignment 1
 */
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <random>
 #include <string>
@@ -18,111 +23,437 @@ Title: Assignment 1
 
 using namespace std;
 
+static atomic<uint64_t> allocations(0); // Number of operator new calls, reported by --bench.
+
+/**
+ * Counting replacement of the global allocation function.
+ */
+void* operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+/**
+ * An order handed from the agent to a chef: the ingredients on offer and the chef they are for. It is a fixed-size
+ * slot that can only be moved, and moving it out leaves the source empty, so a handoff never allocates and an order
+ * cannot be taken twice.
+ */
+struct Order {
+    uint32_t ingredients = 0; // Mask of the ingredients, 0 for no order.
+    int chef = -1; // ID of the chef the order is assigned to, -1 if none.
+    uint64_t enqueued = 0; // Time the agent added the order in steady clock nanoseconds, 0 if not measured.
+
+    Order() = default;
+
+    /**
+     * Constructs an unassigned order.
+     * @param ingredients Mask of the ingredients.
+     * @param enqueued Time the order is added, 0 to skip measuring its latency.
+     */
+    explicit Order(uint32_t ingredients, uint64_t enqueued = 0) : ingredients(ingredients), enqueued(enqueued) {}
+
+    Order(const Order&) = delete;
+    Order& operator=(const Order&) = delete;
+
+    /**
+     * Takes over another order and empties it.
+     * @param other The order to move from.
+     */
+    Order(Order&& other) noexcept : ingredients(other.ingredients), chef(other.chef), enqueued(other.enqueued) {
+        other.ingredients = 0;
+        other.chef = -1;
+        other.enqueued = 0;
+    }
+
+    /**
+     * Takes over another order and empties it.
+     * @param other The order to move from.
+     * @return This order.
+     */
+    Order& operator=(Order&& other) noexcept {
+        ingredients = other.ingredients;
+        chef = other.chef;
+        enqueued = other.enqueued;
+        other.ingredients = 0;
+        other.chef = -1;
+        other.enqueued = 0;
+        return *this;
+    }
+
+    /**
+     * @return True if the slot holds no order.
+     */
+    bool empty() const {
+        return ingredients == 0;
+    }
+};
+
+/**
+ * @return The steady clock time in nanoseconds.
+ */
+uint64_t nowNs() {
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * Latency histogram with one bucket per power of two nanoseconds. Recording never allocates.
+ */
+class LatencyHistogram {
+public:
+    static const int BUCKETS = 64;
+
+    LatencyHistogram() : counts(), total(0), max(0) {}
+
+    /**
+     * Records one sample.
+     * @param ns The latency in nanoseconds.
+     */
+    void record(uint64_t ns) {
+        counts[63 - __builtin_clzll(ns | 1)]++;
+        total++;
+        max = ns > max ? ns : max;
+    }
+
+    /**
+     * Adds the samples of another histogram.
+     * @param other The histogram to add.
+     */
+    void merge(const LatencyHistogram& other) {
+        for (int bucket = 0; bucket < BUCKETS; bucket++) {
+            counts[bucket] += other.counts[bucket];
+        }
+        total += other.total;
+        max = other.max > max ? other.max : max;
+    }
+
+    /**
+     * @param fraction The fraction of samples, e.g. 0.99.
+     * @return The upper bound of the bucket holding that fraction of the samples, in nanoseconds.
+     */
+    uint64_t percentile(double fraction) const {
+        uint64_t target = static_cast<uint64_t>(fraction * total);
+        uint64_t seen = 0;
+        for (int bucket = 0; bucket < BUCKETS; bucket++) {
+            seen += counts[bucket];
+            if (seen > target) {
+                uint64_t upper = bucket < 63 ? uint64_t(1) << (bucket + 1) : UINT64_MAX;
+                return upper < max ? upper : max;
+            }
+        }
+        return max;
+    }
+
+    /**
+     * @return The largest sample.
+     */
+    uint64_t maximum() const {
+        return max;
+    }
+
+private:
+    uint64_t counts[BUCKETS]; // Samples in [2^i, 2^(i+1)) ns
+    uint64_t total;           // Samples recorded
+    uint64_t max;             // Largest sample
+};
+
 /**
- * A Monitor class that provides synchronized access to a shared data structure using mutexes and condition variables.
+ * Interface of a Monitor that passes orders from agents to chefs. Ingredients are bit positions and a set of
+ * ingredients is a bit mask. Each chef registers the mask of ingredients it needs, and an offered mask is dispatched
+ * to a chef through a lookup table indexed by the mask; implementations differ in how the order then reaches the chef.
  */
 class Monitor {
+private:
+    vector<int> table_start; // Offset of each mask's chefs in table_chefs; mask m owns [table_start[m], table_start[m + 1]).
+    vector<int> table_chefs; // Chef IDs grouped by the mask they need.
+    vector<atomic<unsigned>> table_next; // Next chef to serve for each mask, rotating through the mask's chefs.
+    atomic<int> producers; // Agents that have not finished yet.
+
+protected:
+    /**
+     * Picks the chef for an offered mask, rotating through the chefs that need it.
+     * @param ingredients The offered mask.
+     * @return The chef ID, or -1 if no chef needs the mask.
+     */
+    int dispatch(uint32_t ingredients) {
+        int first = table_start[ingredients];
+        int count = table_start[ingredients + 1] - first;
+        if (count == 0) {
+            return -1;
+        }
+        unsigned turn = table_next[ingredients].fetch_add(1, memory_order_relaxed);
+        return table_chefs[first + static_cast<int>(turn % count)];
+    }
+
+    /**
+     * Marks one agent as finished.
+     * @return True if it was the last agent.
+     */
+    bool finishProducer() {
+        return producers.fetch_sub(1, memory_order_acq_rel) == 1;
+    }
+
+public:
+    /**
+     * Constructs the dispatch table.
+     * @param ingredients The number of ingredients, at most 16.
+     * @param required The mask of ingredients each chef needs, indexed by chef ID.
+     * @param agents The number of agents adding orders.
+     */
+    Monitor(int ingredients, const vector<uint32_t>& required, int agents)
+        : table_start((size_t(1) << ingredients) + 1, 0), table_chefs(required.size()),
+          table_next(size_t(1) << ingredients), producers(agents) {
+        // Counting sort of the chefs by mask
+        for (uint32_t mask : required) {
+            table_start[mask + 1]++;
+        }
+        for (size_t mask = 1; mask < table_start.size(); mask++) {
+            table_start[mask] += table_start[mask - 1];
+        }
+        vector<int> filled(table_start.begin(), table_start.end() - 1);
+        for (size_t chef = 0; chef < required.size(); chef++) {
+            table_chefs[filled[required[chef]]++] = static_cast<int>(chef);
+        }
+    }
+
+    virtual ~Monitor() = default;
+
+    /**
+     * Adds an order for a chef that needs exactly its ingredients, blocking while there is no room for it.
+     * @param order The order to be added; moved from unless no chef needs its ingredients.
+     * @return The ID of the chef assigned to the order, or -1 if no chef needs the ingredients.
+     */
+    virtual int addItem(Order&& order) = 0;
+
+    /**
+     * Marks one agent as finished. Once every agent has finished, sets the exit flag of every chef.
+     */
+    virtual void setExitFlag() = 0;
+
+    /**
+     * Retrieves the next order for a specific chef, blocking until there is one.
+     * @param assignedChef The ID of the chef.
+     * @return The order, empty once the exit flag is set and no order is left for the chef.
+     */
+    virtual Order getItem(int assignedChef) = 0;
+};
+
+/**
+ * The original Monitor: a single shared order slot behind one mutex and one condition variable. Every handoff wakes
+ * every waiting thread, and agents and chefs take turns. Kept as the baseline for --bench.
+ */
+class SharedMonitor : public Monitor {
 private:
     mutex mtx; // Mutex for synchronizing access to shared data.
     condition_variable cv; // Condition variable for synchronizing threads.
     /**
-     * Struct containing shared data, an exit flag, and an access name to indicate which consumer thread can access the mutex.
+     * Struct containing shared data and an exit flag.
      */
     struct DATA_BUS {
-        vector<string> shared_data; // Vector to store shared data used by threads.
-        string access_name; // Name of the consumer thread allowed to access the mutex.
+        Order shared_data; // The order on the table; its chef is the consumer thread allowed to access the mutex.
         bool exit_flag = false; // Exit flag to end all threads once set to true.
     } bus;
 
 public:
     /**
-     * Adds items to the shared data structure and assigns access to a specific chef.
-     * @param ingredients A vector of ingredients to be added.
-     * @param assignedChef The name of the chef assigned to access the shared data.
+     * Constructs a SharedMonitor.
+     * @param ingredients The number of ingredients, at most 16.
+     * @param required The mask of ingredients each chef needs, indexed by chef ID.
+     * @param agents The number of agents adding orders.
      */
-    void addItem(vector<string>& ingredients, string assignedChef) {
-        unique_lock<mutex> lock(mtx); // Lock the mutex.
-        cv.wait(lock, [this]() { return bus.shared_data.empty() && bus.access_name == ""; }); ///< Wait until shared data is empty.
-        bus.access_name = assignedChef; // Assign the specific chef to shared data.
-        for (string& ingredient : ingredients) {
-            bus.shared_data.push_back(ingredient); // Add data.
+    SharedMonitor(int ingredients, const vector<uint32_t>& required, int agents) : Monitor(ingredients, required, agents) {}
+
+    int addItem(Order&& order) override {
+        int assignedChef = dispatch(order.ingredients);
+        if (assignedChef < 0) {
+            return -1;
         }
+        unique_lock<mutex> lock(mtx); // Lock the mutex.
+        cv.wait(lock, [this]() { return bus.shared_data.empty(); }); ///< Wait until shared data is empty.
+        order.chef = assignedChef;
+        bus.shared_data = move(order); // Add data.
         cv.notify_all(); // Notify all threads.
+        return assignedChef;
     }
-    /**
-     * Sets exit flag to true.
-     */
-    void setExitFlag() {
+
+    void setExitFlag() override {
+        if (!finishProducer()) {
+            return;
+        }
         unique_lock<mutex> lock(mtx);
         bus.exit_flag = true;
         cv.notify_all(); // Notify all chef threads to exit.
     }
 
+    Order getItem(int assignedChef) override {
+        unique_lock<mutex> lock(mtx); // Lock the mutex.
+        cv.wait(lock, [this, assignedChef]() { return bus.shared_data.chef == assignedChef || bus.exit_flag == true; }); ///< Wait for data assigned to this chef or wait for exit flag.
+        if (bus.shared_data.chef != assignedChef) {
+            return Order();
+        }
+        Order results = move(bus.shared_data); // Take the order, which clears shared data.
+        cv.notify_all(); // Notify agents and chefs.
+        return results;
+    }
+};
+
+/**
+ * A Monitor that queues orders per chef: every chef owns a bounded ring of order slots with its own mutex and
+ * condition variables. Any number of agents can add orders concurrently, and they only contend when they pick the
+ * same chef. An agent blocks only while the chosen chef's ring is full, so agents and chefs overlap instead of taking
+ * turns, and a handoff wakes only the assigned chef.
+ */
+class PartitionedMonitor : public Monitor {
+private:
+    /**
+     * Bounded ring of orders for one chef, on its own cache lines.
+     */
+    struct alignas(64) ChefQueue {
+        mutex mtx; // Mutex for synchronizing access to the ring.
+        condition_variable not_empty; // Condition variable the chef waits on for an order.
+        condition_variable not_full; // Condition variable agents wait on for a free slot.
+        vector<Order> slots; // The ring of order slots.
+        size_t head = 0; // Slot of the oldest order.
+        size_t count = 0; // Number of queued orders.
+        bool exit_flag = false; // Exit flag to end the chef once its ring is drained.
+    };
+
+    vector<ChefQueue> queues; // One queue per chef, indexed by chef ID.
+
+public:
     /**
-     * Retrieves items from the shared data structure for a specific chef.
-     * @param assignedChef The name of the chef assigned to access the shared data.
-     * @return A vector of strings containing the retrieved ingredients.
+     * Constructs a PartitionedMonitor and the chefs' queues.
+     * @param ingredients The number of ingredients, at most 16.
+     * @param required The mask of ingredients each chef needs, indexed by chef ID.
+     * @param agents The number of agents adding orders.
+     * @param capacity The number of order slots per chef, at least 1.
      */
-    vector<string> getItem(string assignedChef) {
-        unique_lock<mutex> lock(mtx); // Lock the mutex.
-        vector<string> results; // Vector to store results for the chef.
+    PartitionedMonitor(int ingredients, const vector<uint32_t>& required, int agents, size_t capacity)
+        : Monitor(ingredients, required, agents), queues(required.size()) {
+        for (ChefQueue& queue : queues) {
+            queue.slots.resize(capacity);
+        }
+    }
 
-        cv.wait(lock, [this, assignedChef]() { return (bus.shared_data.size() == 2 && bus.access_name == assignedChef) || bus.exit_flag == true; }); ///< Wait for 2 elements in shared data or wait for exit flag.
-        if (bus.exit_flag == true) {
-            return {};
+    int addItem(Order&& order) override {
+        int assignedChef = dispatch(order.ingredients); // Assign the next chef needing these ingredients.
+        if (assignedChef < 0) {
+            return -1;
+        }
+        ChefQueue& queue = queues[assignedChef];
+        {
+            unique_lock<mutex> lock(queue.mtx); // Lock the chef's queue.
+            queue.not_full.wait(lock, [&queue]() { return queue.count < queue.slots.size(); }); ///< Wait for a free slot.
+            order.chef = assignedChef;
+            queue.slots[(queue.head + queue.count) % queue.slots.size()] = move(order); // Add data.
+            queue.count++;
         }
-        for (string data : bus.shared_data) {
-            results.push_back(data); // Add data to results.
+        queue.not_empty.notify_one(); // Notify the assigned chef only, after unlocking so it does not wake into a held mutex.
+        return assignedChef;
+    }
+
+    void setExitFlag() override {
+        if (!finishProducer()) {
+            return;
         }
-        bus.shared_data.clear(); // Clear shared data.
-        bus.access_name = "";
-        cv.notify_all(); // Notify agent and chefs.
+        for (ChefQueue& queue : queues) {
+            {
+                unique_lock<mutex> lock(queue.mtx);
+                queue.exit_flag = true;
+            }
+            queue.not_empty.notify_all(); // Notify the chef thread to exit.
+        }
+    }
+
+    Order getItem(int assignedChef) override {
+        Order results; // The order for the chef.
+        ChefQueue& queue = queues[assignedChef];
+        {
+            unique_lock<mutex> lock(queue.mtx); // Lock the chef's queue.
+            queue.not_empty.wait(lock, [&queue]() { return queue.count > 0 || queue.exit_flag == true; }); ///< Wait for an order or wait for exit flag.
+            if (queue.count == 0) { // Orders already queued are still taken after the exit flag is set
+                return results;
+            }
+            results = move(queue.slots[queue.head]); // Take the order, which empties its slot.
+            queue.head = (queue.head + 1) % queue.slots.size();
+            queue.count--;
+        }
+        queue.not_full.notify_one(); // Notify an agent waiting for a slot.
         return results;
     }
 };
 
+/**
+ * Lists the names of the ingredients in a mask.
+ * @param names Names of the ingredients, indexed by bit position.
+ * @param mask The mask.
+ * @return The names joined with "and".
+ */
+string describe(const vector<string>& names, uint32_t mask) {
+    string text;
+    for (size_t i = 0; i < names.size(); i++) {
+        if (mask & (1u << i)) {
+            text += (text.empty() ? "" : " and ") + names[i];
+        }
+    }
+    return text;
+}
+
 /**
  * Agent class responsible for adding ingredients to the monitor.
  */
 class Agent {
 private:
     Monitor& monitor; // Reference to the monitor instance.
-    vector<string> ingredients; // List of ingredients.
+    vector<uint32_t> offers; // Ingredient masks that some chef needs.
+    const vector<string>& names; // Names of the ingredients, for output.
     int runs; // Number of runs to perform.
+    bool quiet; // Skip the output and sleeps when benchmarking.
+    const atomic<bool>& start; // Set once every thread has been created.
 
 public:
     /**
      * Constructs an Agent object.
      * @param mon Reference to the monitor instance.
-     * @param items List of ingredients.
+     * @param offers Ingredient masks to choose from.
+     * @param names Names of the ingredients.
      * @param runs Number of runs to perform.
+     * @param quiet True to skip the output and sleeps.
+     * @param start Flag the agent waits for before adding ingredients.
      */
-    Agent(Monitor& mon, vector<string> items, int runs) : monitor(mon), ingredients(items), runs(runs) {}
+    Agent(Monitor& mon, vector<uint32_t> offers, const vector<string>& names, int runs, bool quiet, const atomic<bool>& start)
+        : monitor(mon), offers(move(offers)), names(names), runs(runs), quiet(quiet), start(start) {}
 
     /**
-     * Adds ingredients to the monitor in random pairs.
+     * Adds a random one of the offered ingredient sets to the monitor on each run.
      */
     void addIngredients() {
         random_device rd;
         mt19937 gen(rd()); // Random number generator.
+        uniform_int_distribution<size_t> dis(0, offers.size() - 1);
 
+        while (!start.load(memory_order_acquire)) {
+            this_thread::yield(); // Wait for the other agents to be created.
+        }
         for (int i = 0; i < runs; i++) {
-            vector<string> copy = ingredients;
-            vector<string> results;
-
-            for (int i = 2; i > 0; i--) {
-                uniform_int_distribution<> dis(0, i);
-                int randomIndex = dis(gen); // Generate a random index.
-
-                results.push_back(copy[randomIndex]); // Add ingredient to results.
-                copy.erase(copy.begin() + randomIndex); // Remove selected ingredient.
+            uint32_t results = offers[dis(gen)]; // Pick a random ingredient set.
+            monitor.addItem(Order(results, quiet ? nowNs() : 0)); ///< Add items to shared data, timed when quiet.
+            if (!quiet) {
+                cout << "Agent added " << describe(names, results) << " to shared data" << endl;
+                this_thread::sleep_for(chrono::milliseconds(1)); ///< Sleep to prevent jumbled output.
             }
-
-            monitor.addItem(results, copy[0]); ///< Add items to shared data.
-            cout << "Agent added " << results[0] << " and " << results[1] << " to shared data" << endl;
-            this_thread::sleep_for(chrono::milliseconds(1)); ///< Sleep to prevent jumbled output.
         }
-        monitor.setExitFlag(); // Sets exit flag to terminate all chef threads once agent has completed all runs
+        monitor.setExitFlag(); // Sets exit flag to terminate all chef threads once every agent has completed all runs
     }
 };
 
@@ -132,62 +463,267 @@ public:
 class Chef {
 private:
     Monitor& monitor; // Reference to the monitor instance.
-    string ingredient; // Ingredient required by the chef.
-    mutex mtx; // Mutex for synchronizing access to shared data.
-    condition_variable cv; // Condition variable for synchronizing threads.
+    string ingredient; // Ingredient the chef holds, for output.
+    int id; // ID of the chef in the monitor.
+    bool quiet; // Skip the output and sleeps when benchmarking.
+    uint64_t made = 0; // Sandwiches made by this chef.
+    LatencyHistogram latency; // Time from an agent adding an order to this chef taking it.
 
 public:
-    static int num_runs; // Number of runs to perform.
+    static atomic<int> num_runs; // Number of runs to perform, shared by all chefs.
     /**
      * Constructs a Chef object.
      * @param mon Reference to the monitor instance.
-     * @param item Ingredient required by the chef.
+     * @param item Ingredient the chef holds.
+     * @param id ID of the chef in the monitor.
+     * @param quiet True to skip the output and sleeps.
      */
-    Chef(Monitor& mon, string item) : monitor(mon), ingredient(item) {}
+    Chef(Monitor& mon, string item, int id, bool quiet) : monitor(mon), ingredient(item), id(id), quiet(quiet) {}
 
     /**
      * Removes ingredients from the monitor and consumes them.
      */
     void removeIngredients() {
         while(num_runs > 0) {
-            lock_guard<mutex> lock(mtx); // Lock the mutex.
-            vector<string> ingredients = monitor.getItem(ingredient); // Retrieve items from shared data.
-            if (ingredients.empty()) { // empty ingredients signify that exit flag has been called, so terminate thread
+            Order order = monitor.getItem(id); // Retrieve items from shared data.
+            if (order.empty()) { // an empty order signifies that exit flag has been called, so terminate thread
                 break;
             }
-            cout << "Chef with " << ingredient << " made and ate the sandwich" << endl;
+            if (order.enqueued != 0) {
+                latency.record(nowNs() - order.enqueued);
+            }
+            made++;
             num_runs--;
-            cv.notify_all(); // Notify all threads.
-            this_thread::sleep_for(chrono::milliseconds(1)); // Sleep to prevent jumbled output.
+            if (!quiet) {
+                cout << "Chef with " << ingredient << " made and ate the sandwich" << endl;
+                this_thread::sleep_for(chrono::milliseconds(1)); // Sleep to prevent jumbled output.
+            }
         }
     }
+
+    /**
+     * @return The number of sandwiches this chef made.
+     */
+    uint64_t getMade() const {
+        return made;
+    }
+
+    /**
+     * @return The handoff latencies of this chef's orders.
+     */
+    const LatencyHistogram& getLatency() const {
+        return latency;
+    }
 };
 
 // Due to Cpp constraits and without a header file, we must initialize static value outside of chef and main
-int Chef::num_runs = 1000;
+atomic<int> Chef::num_runs{1000};
+
+/**
+ * Configuration of a simulation run.
+ */
+struct RunConfig {
+    string monitor = "partitioned"; // Monitor implementation, "partitioned" or "shared".
+    int chefs = 0; // Number of chefs, at least one per ingredient.
+    int agents = 1; // Number of agents.
+    int capacity = 1; // Order slots per chef; the shared monitor always has one slot.
+    int runs = 1000; // Number of sandwiches to make, split between the agents.
+    bool quiet = false; // Skip the output and sleeps, and time every handoff.
+};
+
+/**
+ * Outcome of a simulation run.
+ */
+struct RunResult {
+    double seconds; // Elapsed time.
+    uint64_t allocations; // Allocations made by all threads while the agents were running.
+    LatencyHistogram latency; // Time from an agent adding an order to a chef taking it, when quiet.
+    double fairness; // Jain's fairness index of the sandwiches made per chef: 1 if equal, 1/chefs if one chef made all.
+};
+
+/**
+ * Runs a number of agents and chefs until every sandwich is made. Chef i holds ingredient i modulo the number
+ * of ingredients and needs all of the others.
+ * @param names Names of the ingredients, at most 16.
+ * @param config The run configuration.
+ * @return The elapsed time, the allocations made during the handoffs, the handoff latencies and the fairness.
+ */
+RunResult simulate(const vector<string>& names, const RunConfig& config) {
+    int kinds = static_cast<int>(names.size());
+    uint32_t all = (1u << kinds) - 1;
+    vector<uint32_t> required;
+    for (int i = 0; i < config.chefs; i++) {
+        required.push_back(all & ~(1u << (i % kinds))); // Everything but the ingredient chef i holds.
+    }
+    vector<uint32_t> offers(required.begin(), required.begin() + min(config.chefs, kinds));
+
+    unique_ptr<Monitor> monitor; // Initialize the monitor.
+    if (config.monitor == "shared") {
+        monitor = make_unique<SharedMonitor>(kinds, required, config.agents);
+    } else {
+        monitor = make_unique<PartitionedMonitor>(kinds, required, config.agents, config.capacity);
+    }
+    Chef::num_runs = config.runs;
+    atomic<bool> start(false);
+
+    vector<unique_ptr<Agent>> producers;
+    for (int i = 0; i < config.agents; i++) {
+        int share = config.runs / config.agents + (i < config.runs % config.agents ? 1 : 0);
+        producers.push_back(make_unique<Agent>(*monitor, offers, names, share, config.quiet, start)); // Initialize agent i.
+    }
+    vector<unique_ptr<Chef>> cooks;
+    for (int i = 0; i < config.chefs; i++) {
+        cooks.push_back(make_unique<Chef>(*monitor, names[i % kinds], i, config.quiet)); // Initialize chef i.
+    }
+
+    vector<thread> chefThreads;
+    for (unique_ptr<Chef>& cook : cooks) {
+        chefThreads.emplace_back(&Chef::removeIngredients, cook.get()); // Start chef thread.
+    }
+    vector<thread> agentThreads;
+    for (unique_ptr<Agent>& producer : producers) {
+        agentThreads.emplace_back(&Agent::addIngredients, producer.get()); // Start agent thread.
+    }
+
+    // Thread creation allocates, so counting starts once every thread exists
+    uint64_t before = allocations.load(memory_order_relaxed);
+    auto begin = chrono::steady_clock::now();
+    start.store(true, memory_order_release);
+    for (thread& agentThread : agentThreads) {
+        agentThread.join(); // Join agent thread.
+    }
+    for (thread& chefThread : chefThreads) {
+        chefThread.join(); // Join chef thread.
+    }
+    RunResult result;
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    result.allocations = allocations.load(memory_order_relaxed) - before;
+
+    double sum = 0, squares = 0;
+    for (unique_ptr<Chef>& cook : cooks) {
+        result.latency.merge(cook->getLatency());
+        double made = static_cast<double>(cook->getMade());
+        sum += made;
+        squares += made * made;
+    }
+    result.fairness = squares > 0 ? sum * sum / (config.chefs * squares) : 1.0;
+    return result;
+}
+
+/**
+ * Prints one line summarizing a quiet run.
+ * @param kinds The number of ingredients.
+ * @param config The run configuration.
+ * @param result The outcome of the run.
+ */
+void report(int kinds, const RunConfig& config, const RunResult& result) {
+    cout << config.monitor << ", ingredients " << kinds << ", chefs " << config.chefs << ", agents " << config.agents
+         << ", capacity " << (config.monitor == "shared" ? 1 : config.capacity) << ": "
+         << static_cast<long>(config.runs / result.seconds) << " sandwiches/sec, latency p50 "
+         << result.latency.percentile(0.5) << " ns, p90 " << result.latency.percentile(0.9) << " ns, p99 "
+         << result.latency.percentile(0.99) << " ns, max " << result.latency.maximum() << " ns, fairness "
+         << result.fairness << ", " << static_cast<double>(result.allocations) / config.runs << " allocations/sandwich\n";
+}
 
 /**
  * Main function to initialize and run the agent and chef threads.
+ * Usage: agent_chef [--ingredients <n>] [--chefs <m>] [--agents <a>] [--capacity <c>] [--runs <r>]
+ *                   [--monitor partitioned|shared] [--quiet] [--bench]
+ * With --quiet, runs without output or sleeps and prints sandwiches/sec, handoff latency percentiles, fairness
+ * between the chefs and allocations. --bench does the same for both monitors over increasing numbers of chefs and
+ * queue capacities, keeping any of them that are given.
  */
-int main() {
-    Monitor monitor; // Initialize the monitor.
-    vector<string> ingredients = {"bread", "butter", "jam"}; // Ingredients for sandwiches.
-    int runs = Chef::num_runs; // Number of runs.
-
-    Agent agent(monitor, ingredients, runs); // Initialize the agent.
-    Chef breadChef(monitor, ingredients[0]); // Initialize bread chef.
-    Chef butterChef(monitor, ingredients[1]); // Initialize butter chef.
-    Chef jamChef(monitor, ingredients[2]); // Initialize jam chef.
-
-    thread agentThread(&Agent::addIngredients, &agent); // Start agent thread.
-    thread breadChefThread(&Chef::removeIngredients, &breadChef); // Start bread chef thread.
-    thread butterChefThread(&Chef::removeIngredients, &butterChef); // Start butter chef thread.
-    thread jamChefThread(&Chef::removeIngredients, &jamChef); // Start jam chef thread.
-
-    agentThread.join(); // Join agent thread.
-    breadChefThread.join(); // Join bread chef thread.
-    butterChefThread.join(); // Join butter chef thread.
-    jamChefThread.join(); // Join jam chef thread.
+int main(int argc, char* argv[]) {
+    int kinds = 3; // Number of ingredients.
+    RunConfig config;
+    config.chefs = 0; // 0 for one per ingredient.
+    config.capacity = 0; // 0 for the default.
+    config.runs = 0; // 0 for the default.
+    string monitor; // Empty for the default.
+    bool bench = false;
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--bench") {
+            bench = true;
+        } else if (option == "--quiet") {
+            config.quiet = true;
+        } else if (i + 1 < argc && option == "--ingredients") {
+            kinds = atoi(argv[++i]);
+        } else if (i + 1 < argc && option == "--chefs") {
+            config.chefs = atoi(argv[++i]);
+        } else if (i + 1 < argc && option == "--agents") {
+            config.agents = atoi(argv[++i]);
+        } else if (i + 1 < argc && option == "--capacity") {
+            config.capacity = atoi(argv[++i]);
+        } else if (i + 1 < argc && option == "--runs") {
+            config.runs = atoi(argv[++i]);
+        } else if (i + 1 < argc && option == "--monitor") {
+            monitor = argv[++i];
+        } else {
+            kinds = 0;
+            break;
+        }
+    }
+    if (kinds < 2 || kinds > 16 || (config.chefs != 0 && config.chefs < kinds) || config.agents < 1 ||
+        config.capacity < 0 || config.runs < 0 || !(monitor.empty() || monitor == "partitioned" || monitor == "shared")) {
+        cerr << "Usage: " << argv[0] << " [--ingredients <2-16>] [--chefs <at least one per ingredient>] [--agents <n>]"
+             << " [--capacity <slots per chef>] [--runs <n>] [--monitor partitioned|shared] [--quiet] [--bench]" << endl;
+        return 1;
+    }
 
+    vector<string> names = {"bread", "butter", "jam"}; // Ingredients for sandwiches.
+    names.resize(kinds);
+    for (int i = 3; i < kinds; i++) {
+        names[i] = "ingredient " + to_string(i);
+    }
+
+    if (bench) {
+        config.quiet = true;
+        config.runs = config.runs ? config.runs : 100000; // Number of sandwiches per measurement.
+        vector<int> counts;
+        if (config.chefs) {
+            counts.push_back(config.chefs);
+        } else {
+            for (int factor = 1; factor <= 32; factor *= 2) {
+                counts.push_back(kinds * factor);
+            }
+        }
+        vector<string> monitors;
+        if (monitor.empty() || monitor == "shared") {
+            monitors.push_back("shared");
+        }
+        if (monitor.empty() || monitor == "partitioned") {
+            monitors.push_back("partitioned");
+        }
+        vector<int> capacities;
+        if (config.capacity) {
+            capacities.push_back(config.capacity);
+        } else {
+            capacities = {1, 8, 64};
+        }
+        for (int count : counts) {
+            for (const string& kind : monitors) {
+                for (int slots : capacities) {
+                    if (kind == "shared" && slots != capacities.front()) {
+                        continue; // The shared monitor has a single slot
+                    }
+                    config.chefs = count;
+                    config.monitor = kind;
+                    config.capacity = slots;
+                    report(kinds, config, simulate(names, config));
+                }
+            }
+        }
+        return 0;
+    }
+
+    config.chefs = config.chefs ? config.chefs : kinds;
+    config.capacity = config.capacity ? config.capacity : 1;
+    config.runs = config.runs ? config.runs : 1000;
+    config.monitor = monitor.empty() ? config.monitor : monitor;
+    RunResult result = simulate(names, config);
+    if (config.quiet) {
+        report(kinds, config, result);
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,152 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light checkpoint file
+*/
+
+#include "checkpoint.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    /**
+     * Pack a record's small fields into one word.
+     * @param record The record.
+     * @return State in bits 0-7, the pedestrian flag in bit 8, the timer flag in bit 9 and the
+     *         flash counter in bits 32-63.
+     */
+    uint64_t pack(const CheckpointRecord& record) {
+        return uint64_t(record.state) | uint64_t(record.pedestrianWaiting) << 8 | uint64_t(record.timerPending) << 9 |
+               uint64_t(static_cast<uint32_t>(record.flashCounter)) << 32;
+    }
+
+    /**
+     * Unpack the word written by pack.
+     * @param flags The packed word.
+     * @param record Receives the fields.
+     */
+    void unpack(uint64_t flags, CheckpointRecord& record) {
+        record.state = static_cast<uint8_t>(flags & 0xff);
+        record.pedestrianWaiting = (flags >> 8) & 1;
+        record.timerPending = (flags >> 9) & 1;
+        record.flashCounter = static_cast<int32_t>(static_cast<uint32_t>(flags >> 32));
+    }
+}
+
+/**
+ * Open a checkpoint file, creating it if it does not exist.
+ * @param path The file path.
+ * @param slots The number of slots; must match an existing file.
+ */
+CheckpointFile::CheckpointFile(const std::string& path, size_t slots)
+    : fd(-1), slotCount(slots), length(sizeof(Header) + slots * sizeof(Slot)), mapping(MAP_FAILED), slots(nullptr) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("open failed");
+        throw std::runtime_error("Error opening checkpoint file " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        perror("fstat failed");
+        close(fd);
+        throw std::runtime_error("Error reading checkpoint file " + path);
+    }
+    bool created = info.st_size == 0;
+    if (!created && static_cast<size_t>(info.st_size) != length) {
+        close(fd);
+        throw std::runtime_error("Checkpoint file " + path + " has a different number of slots");
+    }
+    // A new file reads as zeros, which is a header to fill in and slots that were never written
+    if (created && ftruncate(fd, static_cast<off_t>(length)) < 0) {
+        perror("ftruncate failed");
+        close(fd);
+        throw std::runtime_error("Error sizing checkpoint file " + path);
+    }
+    mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        perror("mmap failed");
+        close(fd);
+        throw std::runtime_error("Error mapping checkpoint file " + path);
+    }
+
+    Header* header = static_cast<Header*>(mapping);
+    if (created) {
+        header->slotCount = slotCount;
+        header->magic = MAGIC;
+    } else if (header->magic != MAGIC || header->slotCount != slotCount) {
+        munmap(mapping, length);
+        close(fd);
+        throw std::runtime_error("Checkpoint file " + path + " is not a checkpoint file of this size");
+    }
+    this->slots = reinterpret_cast<Slot*>(static_cast<char*>(mapping) + sizeof(Header));
+}
+
+/**
+ * Unmap and close the file.
+ */
+CheckpointFile::~CheckpointFile() {
+    if (mapping != MAP_FAILED) {
+        munmap(mapping, length);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/**
+ * @return The number of slots.
+ */
+size_t CheckpointFile::size() const {
+    return slotCount;
+}
+
+/**
+ * Write a slot under its sequence lock: the sequence is odd while the fields change, and the
+ * release stores keep a reader that sees a new field from missing the odd sequence.
+ * @param slot The slot index.
+ * @param record The record to store.
+ */
+void CheckpointFile::write(size_t slot, const CheckpointRecord& record) {
+    Slot& target = slots[slot];
+    uint64_t sequence = target.sequence.load(std::memory_order_relaxed);
+    target.sequence.store(sequence + 1, std::memory_order_relaxed);
+    target.flags.store(pack(record), std::memory_order_release);
+    target.remainingMs.store(record.remainingMs, std::memory_order_release);
+    target.wallTimeMs.store(record.wallTimeMs, std::memory_order_release);
+    target.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+/**
+ * Read a slot, retrying if a write was in progress.
+ * @param slot The slot index.
+ * @param record Receives the record.
+ * @return False if the slot has never been written.
+ */
+bool CheckpointFile::read(size_t slot, CheckpointRecord& record) const {
+    const Slot& source = slots[slot];
+    for (;;) {
+        uint64_t before = source.sequence.load(std::memory_order_acquire);
+        if (before == 0) return false;
+        uint64_t flags = source.flags.load(std::memory_order_acquire);
+        record.remainingMs = source.remainingMs.load(std::memory_order_acquire);
+        record.wallTimeMs = source.wallTimeMs.load(std::memory_order_acquire);
+        if ((before & 1) == 0 && source.sequence.load(std::memory_order_relaxed) == before) {
+            unpack(flags, record);
+            return true;
+        }
+    }
+}
+
+/**
+ * Write the mapped pages back to the file and wait for the write to finish.
+ */
+void CheckpointFile::sync() {
+    if (msync(mapping, length, MS_SYNC) < 0) {
+        perror("msync failed");
+    }
+}
@@ -0,0 +1,106 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light checkpoint file
+*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * The persisted state of one context.
+ */
+struct CheckpointRecord {
+    uint8_t state;          // StateId of the current state
+    bool pedestrianWaiting; // Pedestrian waiting flag
+    bool timerPending;      // Whether a timer was running
+    int32_t flashCounter;   // Flashes left in PedestriansFlash
+    uint64_t remainingMs;   // Time left on the pending timer when the record was written
+    int64_t wallTimeMs;     // System clock time the record was written, ms since the epoch
+};
+
+/**
+ * Fixed-layout file of context checkpoints, mapped into memory.
+ *
+ * The file is a 64-byte header followed by one 64-byte slot per context. Writing a slot is a few
+ * stores into the mapping under a per-slot sequence lock, with no system call; the kernel writes
+ * the pages back on its own, so the file survives a crash of the process. Reopening an existing
+ * file maps the slots as they were left.
+ */
+class CheckpointFile {
+public:
+    /**
+     * Opens a checkpoint file, creating it if it does not exist.
+     * @param path The file path.
+     * @param slots The number of slots; must match an existing file.
+     * @throws std::runtime_error If the file cannot be created or mapped, or does not match.
+     */
+    CheckpointFile(const std::string& path, size_t slots);
+
+    /**
+     * Unmaps and closes the file.
+     */
+    ~CheckpointFile();
+
+    CheckpointFile(const CheckpointFile&) = delete;
+    CheckpointFile& operator=(const CheckpointFile&) = delete;
+
+    /**
+     * @return The number of slots.
+     */
+    size_t size() const;
+
+    /**
+     * Writes a slot. Each slot must have at most one writer at a time.
+     * @param slot The slot index.
+     * @param record The record to store.
+     */
+    void write(size_t slot, const CheckpointRecord& record);
+
+    /**
+     * Reads a slot. Safe to call while the slot is being written.
+     * @param slot The slot index.
+     * @param record Receives the record.
+     * @return False if the slot has never been written.
+     */
+    bool read(size_t slot, CheckpointRecord& record) const;
+
+    /**
+     * Writes the mapped pages back to the file and waits for the write to finish.
+     */
+    void sync();
+
+private:
+    static const uint64_t MAGIC = 0x313054504b434c54ULL; // "TLCKPT01" in little-endian byte order
+
+    struct Header {
+        uint64_t magic;     // MAGIC
+        uint64_t slotCount; // Number of slots
+        uint64_t reserved[6];
+    };
+
+    /**
+     * One context's record, packed into atomic words so it can be read while being written.
+     */
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence;  // Odd while a write is in progress, 0 if never written
+        std::atomic<uint64_t> flags;     // State, flags and flash counter, see pack
+        std::atomic<uint64_t> remainingMs;
+        std::atomic<int64_t> wallTimeMs;
+    };
+
+    static_assert(sizeof(Header) == 64 && sizeof(Slot) == 64, "checkpoint layout changed");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "slots must be lock-free to live in a file");
+
+    int fd;              // File descriptor of the file
+    size_t slotCount;    // Number of slots
+    size_t length;       // Length of the mapping in bytes
+    void* mapping;       // The mapped file
+    Slot* slots;         // First slot in the mapping
+};
+
+#endif
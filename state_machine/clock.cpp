@@ -0,0 +1,278 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light clocks
+*/
+
+#include "clock.h"
+#include "main.h"
+
+#include <algorithm>
+
+namespace {
+    /**
+     * @return A vector for expired timers reused by the calling thread, so stepping a simulated
+     *         clock stops allocating once the vector has grown.
+     */
+    std::vector<TimerExpiry>& expiredScratch() {
+        thread_local std::vector<TimerExpiry> expired;
+        return expired;
+    }
+}
+
+/**
+ * Register a context that uses this clock. Clocks that do not track their contexts ignore it.
+ * @param context The context.
+ */
+void Clock::attach(Context*) {}
+
+/**
+ * Unregister a context that uses this clock.
+ * @param context The context.
+ */
+void Clock::detach(Context*) {}
+
+/**
+ * @return The shared real-time clock, started on first use.
+ */
+RealTimeClock& RealTimeClock::instance() {
+    static RealTimeClock clock;
+    return clock;
+}
+
+/**
+ * Constructs the RealTimeClock and starts its thread.
+ */
+RealTimeClock::RealTimeClock() : wakeTick(UINT64_MAX), running(true), start(std::chrono::steady_clock::now()) {
+    thread = std::thread(&RealTimeClock::run, this);
+}
+
+/**
+ * Stops the timer thread. Pending timers are discarded.
+ */
+RealTimeClock::~RealTimeClock() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = false;
+    }
+    cv.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+/**
+ * @return The number of milliseconds since the clock started.
+ */
+uint64_t RealTimeClock::now() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Schedule a timer that queues a TIMEOUT event on a context.
+ * @param target The context to deliver the timeout to.
+ * @param delay The time until the timer expires.
+ * @param generation The context's timer generation, handed back on expiry.
+ * @return The handle of the new timer.
+ */
+TimerId RealTimeClock::schedule(Context* target, std::chrono::milliseconds delay, uint64_t generation) {
+    uint64_t deadline = now() + delay.count();
+    TimerId id;
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        id = wheel.schedule(deadline, target, generation);
+        wake = deadline < wakeTick;
+    }
+    if (wake) {
+        cv.notify_one();
+    }
+    return id;
+}
+
+/**
+ * Cancel a timer.
+ * @param id The handle returned by schedule.
+ * @return True if the timer was pending and is now cancelled.
+ */
+bool RealTimeClock::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return wheel.cancel(id);
+}
+
+/**
+ * Wait until no expired timer is being delivered.
+ */
+void RealTimeClock::synchronize() {
+    std::lock_guard<std::mutex> lock(deliveryMtx);
+}
+
+/**
+ * Timer thread: advance the wheel, deliver expired timers and sleep until the next deadline.
+ */
+void RealTimeClock::run() {
+    std::vector<TimerExpiry> expired;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (running) {
+        wheel.advanceTo(now(), expired);
+        if (!expired.empty()) {
+            // Deliver without holding the wheel lock so contexts can schedule their next timer.
+            // The delivery lock is taken before the wheel lock is released, so a context that
+            // cancels its timer and then synchronizes cannot miss an in-flight delivery.
+            std::unique_lock<std::mutex> delivery(deliveryMtx);
+            lock.unlock();
+            for (const TimerExpiry& expiry : expired) {
+                expiry.target->timerExpired(expiry.tag);
+            }
+            expired.clear();
+            delivery.unlock();
+            lock.lock();
+            continue;
+        }
+        uint64_t deadline;
+        if (wheel.nextDeadline(deadline)) {
+            wakeTick = deadline;
+            cv.wait_until(lock, start + std::chrono::milliseconds(deadline));
+        } else {
+            wakeTick = UINT64_MAX;
+            cv.wait(lock);
+        }
+        wakeTick = UINT64_MAX;
+    }
+}
+
+/**
+ * Constructs a SimulatedClock at time 0.
+ */
+SimulatedClock::SimulatedClock() {}
+
+/**
+ * @return The simulated time in milliseconds.
+ */
+uint64_t SimulatedClock::now() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return wheel.now();
+}
+
+/**
+ * Schedule a timer relative to the simulated time.
+ * @param target The context to deliver the timeout to.
+ * @param delay The time until the timer expires.
+ * @param generation The context's timer generation, handed back on expiry.
+ * @return The handle of the new timer.
+ */
+TimerId SimulatedClock::schedule(Context* target, std::chrono::milliseconds delay, uint64_t generation) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return wheel.schedule(wheel.now() + delay.count(), target, generation);
+}
+
+/**
+ * Cancel a timer.
+ * @param id The handle returned by schedule.
+ * @return True if the timer was pending and is now cancelled.
+ */
+bool SimulatedClock::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return wheel.cancel(id);
+}
+
+/**
+ * Wait until no expired timer is being delivered.
+ */
+void SimulatedClock::synchronize() {
+    std::lock_guard<std::mutex> lock(deliveryMtx);
+}
+
+/**
+ * Register a context so advance waits for it between deadlines.
+ * @param context The context.
+ */
+void SimulatedClock::attach(Context* context) {
+    std::lock_guard<std::mutex> lock(mtx);
+    contexts.push_back(context);
+}
+
+/**
+ * Unregister a context.
+ * @param context The context.
+ */
+void SimulatedClock::detach(Context* context) {
+    std::lock_guard<std::mutex> lock(mtx);
+    contexts.erase(std::remove(contexts.begin(), contexts.end(), context), contexts.end());
+}
+
+/**
+ * Move time forward, firing every timer that falls due on the way.
+ * @param duration The amount of simulated time to move forward.
+ */
+void SimulatedClock::advance(std::chrono::milliseconds duration) {
+    settle();
+    std::vector<TimerExpiry>& expired = expiredScratch();
+    std::unique_lock<std::mutex> lock(mtx);
+    uint64_t target = wheel.now() + duration.count();
+    uint64_t deadline;
+    while (wheel.nextDeadline(deadline) && deadline <= target) {
+        wheel.advanceTo(deadline, expired);
+        deliver(lock, expired);
+        lock.lock();
+    }
+    wheel.advanceTo(target, expired);
+    expired.clear();
+}
+
+/**
+ * Move time forward to the next pending deadline and fire the timers due there.
+ * @return True if a timer fired, false if no timer was pending.
+ */
+bool SimulatedClock::step() {
+    settle();
+    std::vector<TimerExpiry>& expired = expiredScratch();
+    std::unique_lock<std::mutex> lock(mtx);
+    uint64_t deadline;
+    if (!wheel.nextDeadline(deadline)) return false;
+    wheel.advanceTo(deadline, expired);
+    deliver(lock, expired);
+    return true;
+}
+
+/**
+ * Get the next pending deadline.
+ * @param deadline Receives the deadline, in clock milliseconds.
+ * @return False if no timer is pending.
+ */
+bool SimulatedClock::nextDeadline(uint64_t& deadline) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return wheel.nextDeadline(deadline);
+}
+
+/**
+ * Deliver expired timers and wait for the attached contexts to go idle.
+ * @param lock The held wheel lock; released on return.
+ * @param expired The timers to deliver; cleared on return.
+ */
+void SimulatedClock::deliver(std::unique_lock<std::mutex>& lock, std::vector<TimerExpiry>& expired) {
+    {
+        // Taken before the wheel lock is released, as in RealTimeClock::run
+        std::lock_guard<std::mutex> delivery(deliveryMtx);
+        lock.unlock();
+        for (const TimerExpiry& expiry : expired) {
+            expiry.target->timerExpired(expiry.tag);
+        }
+    }
+    expired.clear();
+    settle();
+}
+
+/**
+ * Wait until every attached context has processed its queued events.
+ */
+void SimulatedClock::settle() {
+    // Reused by the thread, like the expired timers, so settling does not allocate
+    thread_local std::vector<Context*> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        snapshot.assign(contexts.begin(), contexts.end());
+    }
+    for (Context* context : snapshot) {
+        context->waitUntilIdle();
+    }
+}
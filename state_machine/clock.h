@@ -0,0 +1,169 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light clocks
+*/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "timer_wheel.h"
+
+/**
+ * Source of time and timers for state machines. A Context reads the time and schedules its
+ * timers through the clock it was constructed with, so the same machine can run against the
+ * steady clock or against simulated time.
+ */
+class Clock {
+public:
+    virtual ~Clock() = default;
+
+    /**
+     * @return The number of milliseconds since the clock started.
+     */
+    virtual uint64_t now() const = 0;
+
+    /**
+     * Schedules a timer that queues a TIMEOUT event on a context.
+     * @param target The context to deliver the timeout to.
+     * @param delay The time until the timer expires.
+     * @param generation The context's timer generation, handed back on expiry.
+     * @return The handle of the new timer.
+     */
+    virtual TimerId schedule(Context* target, std::chrono::milliseconds delay, uint64_t generation) = 0;
+
+    /**
+     * Cancels a timer. The timer may already be expiring; use synchronize to wait for such a
+     * delivery to finish.
+     * @param id The handle returned by schedule.
+     * @return True if the timer was pending and is now cancelled.
+     */
+    virtual bool cancel(TimerId id) = 0;
+
+    /**
+     * Waits until no expired timer is being delivered. After a timer has been cancelled,
+     * this guarantees the clock no longer touches its context.
+     */
+    virtual void synchronize() = 0;
+
+    /**
+     * Registers a context that uses this clock.
+     * @param context The context.
+     */
+    virtual void attach(Context* context);
+
+    /**
+     * Unregisters a context that uses this clock.
+     * @param context The context.
+     */
+    virtual void detach(Context* context);
+};
+
+/**
+ * Process-wide clock backed by the steady clock: one thread drives a shared TimerWheel and
+ * delivers a TIMEOUT event to the owning Context of every expired timer. The thread sleeps
+ * until the earliest deadline rather than waking on every tick.
+ */
+class RealTimeClock : public Clock {
+public:
+    /**
+     * @return The shared real-time clock, started on first use.
+     */
+    static RealTimeClock& instance();
+
+    /**
+     * Stops the timer thread.
+     */
+    ~RealTimeClock() override;
+
+    RealTimeClock(const RealTimeClock&) = delete;
+    RealTimeClock& operator=(const RealTimeClock&) = delete;
+
+    uint64_t now() const override;
+    TimerId schedule(Context* target, std::chrono::milliseconds delay, uint64_t generation) override;
+    bool cancel(TimerId id) override;
+    void synchronize() override;
+
+private:
+    RealTimeClock();
+
+    /**
+     * Timer thread: advances the wheel, delivers expired timers and sleeps until the next deadline.
+     */
+    void run();
+
+    std::mutex mtx;                 // Guards the wheel
+    std::mutex deliveryMtx;         // Held while expired timers are delivered
+    std::condition_variable cv;     // Wakes the timer thread for earlier deadlines and shutdown
+    TimerWheel wheel;               // Pending timers of every context
+    uint64_t wakeTick;              // Tick the timer thread is sleeping until
+    bool running;                   // Flag to run the timer thread
+    std::chrono::steady_clock::time_point start; // Tick 0
+    std::thread thread;             // Timer thread
+};
+
+/**
+ * Deterministic clock for tests and simulations. Time only moves when advance or step is called,
+ * and it jumps straight from one deadline to the next. Expired timers are delivered on the
+ * calling thread, which then waits for every attached context to finish processing its events
+ * before moving on, so each deadline sees the timers the previous one started.
+ */
+class SimulatedClock : public Clock {
+public:
+    /**
+     * Constructs a SimulatedClock at time 0.
+     */
+    SimulatedClock();
+
+    uint64_t now() const override;
+    TimerId schedule(Context* target, std::chrono::milliseconds delay, uint64_t generation) override;
+    bool cancel(TimerId id) override;
+    void synchronize() override;
+    void attach(Context* context) override;
+    void detach(Context* context) override;
+
+    /**
+     * Moves time forward, firing every timer that falls due on the way.
+     * @param duration The amount of simulated time to move forward.
+     */
+    void advance(std::chrono::milliseconds duration);
+
+    /**
+     * Moves time forward to the next pending deadline and fires the timers due there.
+     * @return True if a timer fired, false if no timer was pending.
+     */
+    bool step();
+
+    /**
+     * Gets the next pending deadline.
+     * @param deadline Receives the deadline, in clock milliseconds.
+     * @return False if no timer is pending.
+     */
+    bool nextDeadline(uint64_t& deadline) const;
+
+private:
+    /**
+     * Delivers expired timers and waits for the attached contexts to go idle.
+     * @param lock The held wheel lock; released on return.
+     * @param expired The timers to deliver.
+     */
+    void deliver(std::unique_lock<std::mutex>& lock, std::vector<TimerExpiry>& expired);
+
+    /**
+     * Waits until every attached context has processed its queued events.
+     */
+    void settle();
+
+    mutable std::mutex mtx;         // Guards the wheel and the attached contexts
+    std::mutex deliveryMtx;         // Held while expired timers are delivered
+    TimerWheel wheel;               // Pending timers; the wheel's tick is the simulated time
+    std::vector<Context*> contexts; // Contexts using this clock
+};
+
+#endif
@@ -0,0 +1,107 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light events
+*/
+
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Enumeration representing different types of events in the system.
+ */
+enum class Event : uint8_t { TIMEOUT, PEDESTRIAN_BUTTON, VEHICLE_SENSOR, EMERGENCY_PREEMPTION };
+
+/**
+ * Payload of a TIMEOUT event.
+ */
+struct TimeoutPayload {
+    static const Event TYPE = Event::TIMEOUT;
+    uint64_t generation; // Timer generation the timeout was scheduled under
+};
+
+/**
+ * Payload of a PEDESTRIAN_BUTTON event.
+ */
+struct PedestrianButtonPayload {
+    static const Event TYPE = Event::PEDESTRIAN_BUTTON;
+    uint8_t crosswalk; // Crosswalk whose button was pressed
+};
+
+/**
+ * Payload of a VEHICLE_SENSOR event.
+ */
+struct VehicleSensorPayload {
+    static const Event TYPE = Event::VEHICLE_SENSOR;
+    uint8_t approach; // Approach the sensor watches
+    uint16_t count;   // Vehicles detected since the last report
+};
+
+/**
+ * Payload of an EMERGENCY_PREEMPTION event.
+ */
+struct EmergencyPreemptionPayload {
+    static const Event TYPE = Event::EMERGENCY_PREEMPTION;
+    uint8_t approach; // Approach the emergency vehicle is coming from
+    bool active;      // True when preemption starts, false when it is released
+};
+
+/**
+ * An event and its payload in a fixed-size record, so events can be queued without allocating.
+ * The payload type is chosen by the event type; any trivially copyable struct with a static TYPE
+ * member that fits in PAYLOAD_SIZE bytes can be carried.
+ */
+class EventRecord {
+public:
+    static const size_t PAYLOAD_SIZE = 24;
+
+    /**
+     * Constructs a TIMEOUT record of generation 0, so arrays of records need no initializer.
+     */
+    EventRecord() : EventRecord(TimeoutPayload{0}) {}
+
+    /**
+     * Constructs a record carrying a payload.
+     * @param payload The payload; its TYPE becomes the event type.
+     */
+    template <typename Payload>
+    EventRecord(const Payload& payload) : type(Payload::TYPE) {
+        static_assert(std::is_trivially_copyable<Payload>::value, "event payloads are copied as bytes");
+        static_assert(sizeof(Payload) <= PAYLOAD_SIZE, "event payload does not fit in an EventRecord");
+        static_assert(alignof(Payload) <= alignof(uint64_t), "event payload is over-aligned");
+        std::memset(storage, 0, sizeof(storage));
+        std::memcpy(storage, &payload, sizeof(Payload));
+    }
+
+    /**
+     * @return The event type.
+     */
+    Event event() const {
+        return type;
+    }
+
+    /**
+     * Reads the payload if the record carries one of the requested type.
+     * @param payload Receives the payload.
+     * @return False if the event type does not match.
+     */
+    template <typename Payload>
+    bool get(Payload& payload) const {
+        if (type != Payload::TYPE) return false;
+        std::memcpy(&payload, storage, sizeof(Payload));
+        return true;
+    }
+
+private:
+    Event type;                                         // The event type
+    alignas(uint64_t) unsigned char storage[PAYLOAD_SIZE]; // The payload, zero-padded
+};
+
+static_assert(sizeof(EventRecord) == 32, "EventRecord should stay half a cache line");
+static_assert(std::is_trivially_copyable<EventRecord>::value, "EventRecord is copied through the event queue");
+
+#endif
@@ -0,0 +1,195 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light event queue
+*/
+
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Multi-producer, single-consumer event queue.
+ *
+ * Producers claim slots of a bounded ring with a compare-and-swap and publish them with a
+ * per-slot sequence number, so a push never waits for the consumer or for another producer.
+ * If the ring is full, events spill into a mutex-guarded overflow list. While that list is in use,
+ * later events go to it as well, so no event overtakes one pushed before it; the consumer takes
+ * the list over in one piece. The ring is kept small since every context owns one. The consumer parks
+ * on a futex and is only woken by a producer when it is actually asleep.
+ */
+template <typename T>
+class EventQueue {
+public:
+    /**
+     * Constructs an empty EventQueue.
+     * @param capacity The number of ring slots, a power of two.
+     */
+    explicit EventQueue(size_t capacity = 256)
+        : slots(new Slot[capacity]), mask(capacity - 1), tail(0), head(0), overflowing(false), overflowed(0), epoch(0), waiting(false) {
+        for (size_t i = 0; i < capacity; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    /**
+     * Adds an event and wakes the consumer if it is parked. Safe to call from any thread.
+     * @param value The event.
+     */
+    void push(const T& value) {
+        if (overflowing.load() || !tryPush(value)) {
+            std::lock_guard<std::mutex> lock(overflowMtx);
+            overflow.push_back(value);
+            overflowing.store(true);
+            overflowed++;
+        }
+        // The event was published with a sequentially consistent store, and park sets waiting the
+        // same way before checking for events: either the consumer sees this event or this sees it waiting
+        if (waiting.load() && waiting.exchange(false)) {
+            wake();
+        }
+    }
+
+    /**
+     * Removes the oldest event. Only the consumer may call this.
+     * @param value Receives the event.
+     * @return True if an event was removed, false if the queue was empty.
+     */
+    bool pop(T& value) {
+        Slot& slot = slots[head & mask];
+        if (slot.sequence.load(std::memory_order_acquire) == head + 1) {
+            value = slot.value;
+            slot.sequence.store(head + mask + 1, std::memory_order_release);
+            head++;
+            return true;
+        }
+        if (drained.empty()) {
+            if (!overflowing.load()) return false;
+            // Take the whole overflow list at once so the lock is not contended per event
+            std::lock_guard<std::mutex> lock(overflowMtx);
+            if (overflow.empty()) {
+                overflowing.store(false);
+                return false;
+            }
+            drained.swap(overflow);
+        }
+        value = drained.front();
+        drained.pop_front();
+        return true;
+    }
+
+    /**
+     * Checks for queued events. Only the consumer may call this.
+     * @return True if no published event is waiting.
+     */
+    bool empty() const {
+        return slots[head & mask].sequence.load() != head + 1 && drained.empty() && !overflowing.load();
+    }
+
+    /**
+     * Sleeps until an event is pushed, wake is called or stop returns true. Only the consumer
+     * may call this; it may return spuriously.
+     * @param stop Checked after registering as waiting; the caller must call wake after making it true.
+     */
+    template <typename Stop>
+    void park(Stop stop) {
+        // Producers usually follow up quickly; give them a chance before paying for a futex wait
+        for (int i = 0; i < SPINS; i++) {
+            if (!empty() || stop()) return;
+            std::this_thread::yield();
+        }
+        uint32_t observed = epoch.load(std::memory_order_acquire);
+        waiting.store(true);
+        if (empty() && !stop()) {
+#ifdef __linux__
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch), FUTEX_WAIT_PRIVATE, observed, nullptr, nullptr, 0);
+#else
+            (void)observed;
+            std::this_thread::yield();
+#endif
+        }
+        waiting.store(false, std::memory_order_relaxed);
+    }
+
+    /**
+     * Wakes the consumer if it is parked.
+     */
+    void wake() {
+        epoch.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+    }
+
+    /**
+     * @return The number of events that went through the overflow list because the ring was full.
+     */
+    uint64_t overflowCount() {
+        std::lock_guard<std::mutex> lock(overflowMtx);
+        return overflowed;
+    }
+
+private:
+    static const int SPINS = 16; // Yields before the consumer parks
+
+    struct Slot {
+        std::atomic<size_t> sequence; // Position the slot is free for, or that position + 1 once published
+        T value;                      // The event
+    };
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+
+    /**
+     * Claims and publishes a ring slot.
+     * @param value The event.
+     * @return False if the ring is full.
+     */
+    bool tryPush(const T& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[position & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(position + 1);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::unique_ptr<Slot[]> slots;              // Ring of events
+    size_t mask;                                // Capacity - 1
+    alignas(64) std::atomic<size_t> tail;       // Next position producers claim
+    alignas(64) size_t head;                    // Next position the consumer reads
+    alignas(64) std::atomic<bool> overflowing;  // Overflow list in use; producers bypass the ring
+    std::mutex overflowMtx;                     // Guards overflow and overflowed
+    std::deque<T> overflow;                     // Events that did not fit in the ring
+    std::deque<T> drained;                      // Overflow events taken by the consumer, consumer only
+    uint64_t overflowed;                        // Events ever sent to the overflow list
+    alignas(64) std::atomic<uint32_t> epoch;    // Futex word, bumped on every wake
+    std::atomic<bool> waiting;                  // Consumer is parked or about to park
+};
+
+#endif
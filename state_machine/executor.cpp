@@ -0,0 +1,123 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light executors
+*/
+
+#include "executor.h"
+
+namespace {
+    thread_local const ThreadPoolExecutor* currentPool = nullptr; // Pool the calling thread works for
+    thread_local size_t currentWorker = 0;                        // Index of the calling worker in that pool
+}
+
+/**
+ * Run a task on the calling thread.
+ * @param task The task to run.
+ */
+void InlineExecutor::submit(Task* task) {
+    task->run();
+}
+
+/**
+ * Constructs a ThreadPoolExecutor and starts its workers.
+ * @param threads The number of worker threads, the number of hardware threads if 0.
+ */
+ThreadPoolExecutor::ThreadPoolExecutor(size_t threads) : pending(0), sleepers(0), nextWorker(0), running(true) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers[i]->thread = std::thread(&ThreadPoolExecutor::workerLoop, this, i);
+    }
+}
+
+/**
+ * Stops the workers after the tasks already submitted have run.
+ */
+ThreadPoolExecutor::~ThreadPoolExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(idleMtx);
+        running = false;
+    }
+    idleCv.notify_all();
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+/**
+ * Submit a task to the calling worker's deque, or round-robin from other threads.
+ * @param task The task to run.
+ */
+void ThreadPoolExecutor::submit(Task* task) {
+    size_t index = currentPool == this ? currentWorker : nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mtx);
+        workers[index]->tasks.push_back(task);
+    }
+    // A worker registers as a sleeper before it rechecks pending, so either it sees this task
+    // or this check sees it and wakes it
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(idleMtx);
+        idleCv.notify_one();
+    }
+}
+
+/**
+ * @return The number of worker threads.
+ */
+size_t ThreadPoolExecutor::size() const {
+    return workers.size();
+}
+
+/**
+ * Take the next task for a worker: the front of its own deque, else the back of another's.
+ * @param index The index of the worker.
+ * @return The task, or nullptr if every deque is empty.
+ */
+Task* ThreadPoolExecutor::take(size_t index) {
+    for (size_t i = 0; i < workers.size(); i++) {
+        Worker& worker = *workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(worker.mtx);
+        if (worker.tasks.empty()) continue;
+        Task* task;
+        if (i == 0) {
+            task = worker.tasks.front();
+            worker.tasks.pop_front();
+        } else {
+            task = worker.tasks.back();
+            worker.tasks.pop_back();
+        }
+        pending.fetch_sub(1);
+        return task;
+    }
+    return nullptr;
+}
+
+/**
+ * Worker thread: run tasks until the pool stops and no task is left.
+ * @param index The index of the worker.
+ */
+void ThreadPoolExecutor::workerLoop(size_t index) {
+    currentPool = this;
+    currentWorker = index;
+    for (;;) {
+        if (Task* task = take(index)) {
+            task->run();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idleMtx);
+        sleepers.fetch_add(1);
+        idleCv.wait(lock, [this]() { return pending.load() > 0 || !running; });
+        sleepers.fetch_sub(1);
+        if (!running && pending.load() == 0) break;
+    }
+    currentPool = nullptr;
+}
@@ -0,0 +1,110 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light executors
+*/
+
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A unit of work run by an Executor. The executor does not own its tasks.
+ */
+class Task {
+public:
+    virtual ~Task() = default;
+
+    /**
+     * Runs the task.
+     */
+    virtual void run() = 0;
+};
+
+/**
+ * Runs tasks on threads it manages.
+ */
+class Executor {
+public:
+    virtual ~Executor() = default;
+
+    /**
+     * Submits a task. The task must stay alive until it has run.
+     * @param task The task to run.
+     */
+    virtual void submit(Task* task) = 0;
+};
+
+/**
+ * Runs every task immediately on the thread that submits it.
+ */
+class InlineExecutor : public Executor {
+public:
+    void submit(Task* task) override;
+};
+
+/**
+ * Fixed pool of worker threads with one task deque per worker. A task submitted from a worker
+ * goes to that worker's deque, other submissions are spread round-robin, and a worker whose
+ * deque is empty steals from the back of the others before going to sleep.
+ */
+class ThreadPoolExecutor : public Executor {
+public:
+    /**
+     * Constructs a ThreadPoolExecutor and starts its workers.
+     * @param threads The number of worker threads, the number of hardware threads if 0.
+     */
+    explicit ThreadPoolExecutor(size_t threads = 0);
+
+    /**
+     * Stops the workers after the tasks already submitted have run.
+     */
+    ~ThreadPoolExecutor() override;
+
+    ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+    ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+
+    void submit(Task* task) override;
+
+    /**
+     * @return The number of worker threads.
+     */
+    size_t size() const;
+
+private:
+    struct Worker {
+        std::mutex mtx;          // Guards tasks
+        std::deque<Task*> tasks; // Tasks waiting to run
+        std::thread thread;      // Worker thread
+    };
+
+    /**
+     * Worker thread: runs its own tasks, steals when it has none and sleeps when there are none at all.
+     * @param index The index of the worker.
+     */
+    void workerLoop(size_t index);
+
+    /**
+     * Takes the next task for a worker, stealing if its own deque is empty.
+     * @param index The index of the worker.
+     * @return The task, or nullptr if every deque is empty.
+     */
+    Task* take(size_t index);
+
+    std::vector<std::unique_ptr<Worker>> workers; // One per thread
+    std::atomic<size_t> pending;                  // Tasks submitted but not yet taken
+    std::atomic<size_t> sleepers;                 // Workers waiting on idleCv
+    std::atomic<size_t> nextWorker;               // Round-robin position for outside submissions
+    std::mutex idleMtx;                           // Guards running and the idle wait
+    std::condition_variable idleCv;               // Wakes sleeping workers
+    bool running;                                 // Flag to run the workers
+};
+
+#endif
@@ -0,0 +1,414 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light state machine benchmark
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <time.h>
+#include <vector>
+
+#include "main.h"
+#include "traffic_table.h"
+
+static std::atomic<uint64_t> allocations(0); // Number of operator new calls
+
+/**
+ * Counting replacement of the global allocation function.
+ */
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+/**
+ * Latency histogram with one bucket per power of two nanoseconds. Recording never allocates.
+ */
+class LatencyHistogram {
+public:
+    static const int BUCKETS = 64;
+
+    LatencyHistogram() : counts(), total(0), max(0) {}
+
+    /**
+     * Records one sample.
+     * @param ns The latency in nanoseconds.
+     */
+    void record(uint64_t ns) {
+        int bucket = 0;
+        while (bucket < BUCKETS - 1 && (uint64_t(1) << (bucket + 1)) <= ns) {
+            bucket++;
+        }
+        counts[bucket]++;
+        total++;
+        max = ns > max ? ns : max;
+    }
+
+    /**
+     * @param fraction The fraction of samples, e.g. 0.99.
+     * @return The upper bound of the bucket holding that fraction of the samples, in nanoseconds.
+     */
+    uint64_t percentile(double fraction) const {
+        uint64_t target = static_cast<uint64_t>(fraction * total);
+        uint64_t seen = 0;
+        for (int bucket = 0; bucket < BUCKETS; bucket++) {
+            seen += counts[bucket];
+            if (seen > target) {
+                uint64_t upper = uint64_t(1) << (bucket + 1);
+                return upper < max ? upper : max;
+            }
+        }
+        return max;
+    }
+
+    /**
+     * Writes the histogram as a JSON object: sample count, percentiles, and each non-empty bucket
+     * as [upper bound in ns, count].
+     * @param out The stream to write to.
+     */
+    void writeJson(std::ostream& out) const {
+        out << "{\"samples\": " << total << ", \"p50\": " << percentile(0.5) << ", \"p90\": " << percentile(0.9)
+            << ", \"p99\": " << percentile(0.99) << ", \"max\": " << max << ", \"buckets\": [";
+        bool first = true;
+        for (int bucket = 0; bucket < BUCKETS; bucket++) {
+            if (counts[bucket] == 0) continue;
+            out << (first ? "" : ", ") << "[" << (uint64_t(1) << (bucket + 1)) << ", " << counts[bucket] << "]";
+            first = false;
+        }
+        out << "]}";
+    }
+
+private:
+    uint64_t counts[BUCKETS]; // Samples in [2^i, 2^(i+1)) ns
+    uint64_t total;           // Samples recorded
+    uint64_t max;             // Largest sample
+};
+
+/**
+ * Result of one benchmark run, written as one JSON object.
+ */
+struct BenchmarkResult {
+    std::string name;                                  // Benchmark name
+    std::vector<std::pair<std::string, double>> values; // Parameters and metrics, in output order
+    bool hasLatency = false;                            // Whether latency holds samples to report
+    LatencyHistogram latency;                           // Event-to-transition latency
+
+    /**
+     * Appends a parameter or metric.
+     * @param key The JSON key.
+     * @param value The value.
+     * @return This result, for chaining.
+     */
+    BenchmarkResult& add(const std::string& key, double value) {
+        values.emplace_back(key, value);
+        return *this;
+    }
+
+    /**
+     * Writes the result as a JSON object.
+     * @param out The stream to write to.
+     */
+    void writeJson(std::ostream& out) const {
+        out << "{\"name\": \"" << name << "\"";
+        for (const auto& value : values) {
+            out << ", \"" << value.first << "\": " << value.second;
+        }
+        if (hasLatency) {
+            out << ", \"latency_ns\": ";
+            latency.writeJson(out);
+        }
+        out << "}";
+    }
+};
+
+/**
+ * @return Nanoseconds on the steady clock.
+ */
+uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Measures full pedestrian cycles driven through the event queue on a simulated clock.
+ * Each cycle is VehiclesGreen -> VehiclesYellow -> PedestriansWalk -> PedestriansFlash -> VehiclesGreen.
+ * The clock is stepped one deadline at a time; the time from delivering a timeout to the context
+ * going idle again is recorded whenever that timeout caused a transition.
+ * @param name The benchmark name.
+ * @param cycles The number of cycles to run.
+ * @param executor The executor running the context, nullptr for a dedicated thread.
+ * @param checkpoints File to checkpoint the context into, nullptr for none.
+ * @return The result.
+ */
+BenchmarkResult benchmarkTransitions(const char* name, int cycles, Executor* executor, CheckpointFile* checkpoints = nullptr) {
+    const uint64_t transitionsPerCycle = 4;
+    SimulatedClock clock;
+    std::unique_ptr<Context> owned(executor ? new Context(clock, *executor) : new Context(clock));
+    Context& context = *owned;
+    if (checkpoints) {
+        context.attachCheckpoint(*checkpoints, 0);
+    }
+    context.setState(&VehiclesGreen::instance());
+    clock.advance(std::chrono::seconds(1));
+
+    BenchmarkResult result;
+    result.name = name;
+    result.hasLatency = true;
+    uint64_t events = 0;
+    uint64_t before = allocations.load();
+    uint64_t droppedBefore = Logger::instance().droppedCount();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < cycles; i++) {
+        uint64_t cycleStart = context.getStateSnapshot().sequence;
+        context.pedestrianWaiting();
+        events++;
+        while (context.getStateSnapshot().sequence < cycleStart + transitionsPerCycle) {
+            uint64_t sequence = context.getStateSnapshot().sequence;
+            uint64_t begin = nowNs();
+            clock.step();
+            // step settles the previous delivery first, so wait for this one before timing it
+            context.waitUntilIdle();
+            uint64_t end = nowNs();
+            events++;
+            if (context.getStateSnapshot().sequence != sequence) {
+                result.latency.record(end - begin);
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t allocated = allocations.load() - before;
+
+    uint64_t transitions = static_cast<uint64_t>(cycles) * transitionsPerCycle;
+    return result.add("transitions", transitions)
+        .add("events_per_sec", events / seconds)
+        .add("transitions_per_sec", transitions / seconds)
+        .add("allocations_per_transition", static_cast<double>(allocated) / transitions)
+        .add("log_records_dropped", Logger::instance().droppedCount() - droppedBefore);
+}
+
+/**
+ * Measures pedestrian cycles on every context of a city, all sharing a thread pool.
+ * @param intersections The number of contexts.
+ * @param transitions The approximate total number of transitions to run, spread over the contexts.
+ * @param threads The number of pool threads, the number of hardware threads if 0.
+ * @return The result.
+ */
+BenchmarkResult benchmarkPool(int intersections, int transitions, size_t threads) {
+    SimulatedClock clock;
+    ThreadPoolExecutor pool(threads);
+    std::vector<std::unique_ptr<Context>> contexts;
+    for (int i = 0; i < intersections; i++) {
+        contexts.emplace_back(new Context(clock, pool));
+        contexts.back()->setState(&VehiclesGreen::instance());
+    }
+
+    int rounds = transitions / (intersections * 4);
+    rounds = rounds > 0 ? rounds : 1;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (auto& context : contexts) {
+            context->pedestrianWaiting();
+        }
+        clock.advance(std::chrono::seconds(35));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t total = static_cast<uint64_t>(intersections) * rounds * 4;
+    BenchmarkResult result;
+    result.name = "pool";
+    return result.add("contexts", intersections)
+        .add("threads", pool.size())
+        .add("transitions", total)
+        .add("transitions_per_sec", total / seconds);
+}
+
+/**
+ * @return CPU time consumed by the calling thread, in seconds.
+ */
+double threadCpuSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Measures event injection from several producer threads into one context. Producers measure the
+ * CPU time of their own queueEvent calls, which includes any time spent spinning or in lock
+ * handoffs with the event thread but not time the scheduler gave to other threads. Repeated button
+ * presses are coalesced, so fewer events are dispatched than queued.
+ * @param producers The number of producer threads.
+ * @param eventsPerProducer The number of events each producer queues.
+ * @param burst The number of events a producer queues before waiting for the context to drain them.
+ * @return The result.
+ */
+BenchmarkResult benchmarkProducers(int producers, int eventsPerProducer, int burst) {
+    SimulatedClock clock;
+    Context context(clock);
+    context.setState(&VehiclesGreen::instance());
+
+    std::vector<std::thread> threads;
+    std::vector<double> producerSeconds(producers);
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&context, &producerSeconds, p, eventsPerProducer, burst]() {
+            double spent = 0;
+            for (int i = 0; i < eventsPerProducer; i += burst) {
+                double begin = threadCpuSeconds();
+                for (int j = 0; j < burst && i + j < eventsPerProducer; j++) {
+                    context.pedestrianWaiting();
+                }
+                spent += threadCpuSeconds() - begin;
+                if (burst < eventsPerProducer) {
+                    context.waitUntilIdle();
+                }
+            }
+            producerSeconds[p] = spent;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    context.waitUntilIdle();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double slowest = 0;
+    for (double s : producerSeconds) {
+        slowest = s > slowest ? s : slowest;
+    }
+    uint64_t events = static_cast<uint64_t>(producers) * eventsPerProducer;
+    BenchmarkResult result;
+    result.name = "producers";
+    return result.add("producers", producers)
+        .add("burst", burst)
+        .add("events", events)
+        .add("events_coalesced", context.getCoalescedEventCount())
+        .add("producer_cpu_ns_per_event", slowest * 1e9 / eventsPerProducer)
+        .add("events_per_sec", events / seconds);
+}
+
+/**
+ * Measures dispatch through the transition table version of the traffic light.
+ * @param events The number of events to dispatch.
+ * @return The result.
+ */
+BenchmarkResult benchmarkTable(int events) {
+    // One pedestrian cycle: a button press and the timeouts that carry it back to green
+    const TrafficLight::Event cycle[] = {
+        TrafficLight::Event::PEDESTRIAN_BUTTON, TrafficLight::Event::TIMEOUT, TrafficLight::Event::TIMEOUT,
+        TrafficLight::Event::TIMEOUT, TrafficLight::Event::TIMEOUT, TrafficLight::Event::TIMEOUT,
+        TrafficLight::Event::TIMEOUT, TrafficLight::Event::TIMEOUT, TrafficLight::Event::TIMEOUT,
+        TrafficLight::Event::TIMEOUT, TrafficLight::Event::TIMEOUT, TrafficLight::Event::TIMEOUT};
+    const int cycleLength = sizeof(cycle) / sizeof(cycle[0]);
+    TrafficLightMachine machine(TrafficLight::State::VEHICLES_GREEN);
+
+    uint64_t before = allocations.load();
+    uint64_t taken = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < events; i++) {
+        taken += machine.dispatch(cycle[i % cycleLength]);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    BenchmarkResult result;
+    result.name = "table";
+    return result.add("events", events)
+        .add("transitions", taken)
+        .add("ns_per_event", seconds * 1e9 / events)
+        .add("allocations", allocations.load() - before);
+}
+
+/**
+ * Measures the cost a log call adds to the calling thread. Records are logged in bursts that fit
+ * the thread's ring and the logger is flushed between bursts, so none are dropped and only the
+ * logging calls themselves are timed.
+ * @param bursts The number of bursts to log.
+ * @return The result.
+ */
+BenchmarkResult benchmarkLogging(int bursts) {
+    const int burst = static_cast<int>(Logger::RING_CAPACITY / 2);
+    uint16_t message = Logger::instance().intern("SIGNAL -> {}: {}");
+    Logger::instance().flush();
+
+    uint64_t before = allocations.load();
+    uint64_t droppedBefore = Logger::instance().droppedCount();
+    double seconds = 0;
+    for (int i = 0; i < bursts; i++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < burst; j++) {
+            logMessage(message, "Vehicles", j);
+        }
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        Logger::instance().flush();
+    }
+
+    double calls = static_cast<double>(bursts) * burst;
+    BenchmarkResult result;
+    result.name = "logging";
+    return result.add("calls", calls)
+        .add("ns_per_call", seconds * 1e9 / calls)
+        .add("allocations_per_call", (allocations.load() - before) / calls)
+        .add("records_dropped", Logger::instance().droppedCount() - droppedBefore);
+}
+
+/**
+ * Runs the state machine benchmarks and writes the results to stdout as JSON. Signal and
+ * transition logging is discarded so only the state machine itself is measured.
+ * Usage: fsm_bench [cycles]
+ * @return Exit status code.
+ */
+int main(int argc, char* argv[]) {
+    int cycles = argc > 1 ? std::atoi(argv[1]) : 20000;
+    cycles = cycles > 100 ? cycles : 100;
+    // The logger writes to std::cout; keep the real stdout for the results only
+    std::ostream json(std::cout.rdbuf(nullptr));
+    json.precision(10);
+
+    std::vector<BenchmarkResult> results;
+    results.push_back(benchmarkTransitions("transitions_thread", cycles, nullptr));
+    {
+        InlineExecutor inlineExecutor;
+        results.push_back(benchmarkTransitions("transitions_inline", cycles, &inlineExecutor));
+        const char* path = "/tmp/fsm_bench_checkpoint.bin";
+        std::remove(path);
+        CheckpointFile checkpoints(path, 1);
+        results.push_back(benchmarkTransitions("transitions_inline_checkpoint", cycles, &inlineExecutor, &checkpoints));
+        std::remove(path);
+    }
+    results.push_back(benchmarkTable(cycles * 1000));
+    results.push_back(benchmarkLogging(cycles / 100));
+    for (int intersections : {1, 10, 100, 1000, 10000}) {
+        results.push_back(benchmarkPool(intersections, cycles * 4, 0));
+    }
+    for (int producers : {1, 2, 4, 8}) {
+        results.push_back(benchmarkProducers(producers, cycles * 5, 32));
+        results.push_back(benchmarkProducers(producers, cycles * 5, cycles * 5));
+    }
+
+    json << "{\"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        json << "  ";
+        results[i].writeJson(json);
+        json << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "]}" << std::endl;
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*
+Author: Varrahan Uthayan
+Title: Transition table state machine
+*/
+
+#ifndef FSM_TABLE_H
+#define FSM_TABLE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * State machines declared as a constexpr transition table.
+ *
+ * A definition is a struct providing:
+ *   - State and Event: enums numbered from 0, with STATES and EVENTS giving their sizes
+ *   - Data: the extended state the guards and actions operate on
+ *   - table: a constexpr std::array of Transition rows
+ *   - entry and exit: constexpr std::arrays of one Action per state, nullptr for none
+ *
+ * Rows for the same (state, event) pair must be adjacent; they are tried in order and the first
+ * whose guard passes is taken. A row whose target is its source is an internal transition: only
+ * its action runs. Otherwise the source's exit action, the row's action and the target's entry
+ * action run in that order. The table is checked at compile time and folded into a flat jump
+ * table indexed by (state, event), so dispatch is one array lookup plus the guards of that cell.
+ */
+namespace fsm {
+    /**
+     * One row of a transition table.
+     */
+    template <typename State, typename Event, typename Data>
+    struct Transition {
+        State from;                  // State the row applies in
+        Event event;                 // Event the row handles
+        State to;                    // State after the transition
+        bool (*guard)(const Data&);  // Condition for taking the row, nullptr for always
+        void (*action)(Data&);       // Action run on the transition, nullptr for none
+    };
+
+    /**
+     * Problems a transition table can have.
+     */
+    enum class TableError {
+        NONE,
+        STATE_OUT_OF_RANGE, // A row names a state outside the state enum
+        EVENT_OUT_OF_RANGE, // A row names an event outside the event enum
+        ROWS_NOT_ADJACENT,  // Rows for one (state, event) pair are split by other rows
+        UNREACHABLE_ROW     // A row follows an unguarded row for the same (state, event) pair
+    };
+
+    /**
+     * Checks a transition table.
+     * @return The first problem found, TableError::NONE for a valid table.
+     */
+    template <typename Def>
+    constexpr TableError validate() {
+        const auto& table = Def::table;
+        for (size_t i = 0; i < table.size(); i++) {
+            if (static_cast<size_t>(table[i].from) >= Def::STATES || static_cast<size_t>(table[i].to) >= Def::STATES) {
+                return TableError::STATE_OUT_OF_RANGE;
+            }
+            if (static_cast<size_t>(table[i].event) >= Def::EVENTS) {
+                return TableError::EVENT_OUT_OF_RANGE;
+            }
+        }
+        for (size_t i = 0; i < table.size(); i++) {
+            bool sameAsPrevious = i > 0 && table[i - 1].from == table[i].from && table[i - 1].event == table[i].event;
+            if (sameAsPrevious && table[i - 1].guard == nullptr) {
+                return TableError::UNREACHABLE_ROW;
+            }
+            for (size_t j = 0; j + 1 < i && !sameAsPrevious; j++) {
+                if (table[j].from == table[i].from && table[j].event == table[i].event) {
+                    return TableError::ROWS_NOT_ADJACENT;
+                }
+            }
+        }
+        return TableError::NONE;
+    }
+
+    /**
+     * The rows of a transition table handling one (state, event) pair.
+     */
+    struct Cell {
+        uint16_t first; // Index of the first row
+        uint16_t count; // Number of rows, 0 if the event is ignored in the state
+    };
+
+    /**
+     * Folds a transition table into a jump table indexed by state * EVENTS + event.
+     * @return The jump table.
+     */
+    template <typename Def>
+    constexpr std::array<Cell, Def::STATES * Def::EVENTS> buildJumpTable() {
+        std::array<Cell, Def::STATES * Def::EVENTS> cells{};
+        for (size_t i = 0; i < Def::table.size(); i++) {
+            Cell& cell = cells[static_cast<size_t>(Def::table[i].from) * Def::EVENTS + static_cast<size_t>(Def::table[i].event)];
+            if (cell.count == 0) {
+                cell.first = static_cast<uint16_t>(i);
+            }
+            cell.count++;
+        }
+        return cells;
+    }
+
+    /**
+     * A state machine running a transition table.
+     */
+    template <typename Def>
+    class StateMachine {
+    public:
+        using State = typename Def::State;
+        using Event = typename Def::Event;
+        using Data = typename Def::Data;
+
+        static_assert(Def::table.size() < UINT16_MAX, "transition table has too many rows");
+        static_assert(validate<Def>() != TableError::STATE_OUT_OF_RANGE, "transition table names a state outside the state enum");
+        static_assert(validate<Def>() != TableError::EVENT_OUT_OF_RANGE, "transition table names an event outside the event enum");
+        static_assert(validate<Def>() != TableError::ROWS_NOT_ADJACENT, "rows for the same state and event must be adjacent");
+        static_assert(validate<Def>() != TableError::UNREACHABLE_ROW, "a row follows an unguarded row for the same state and event");
+
+        /**
+         * Constructs a StateMachine in an initial state and runs that state's entry action.
+         * @param initial The initial state.
+         * @param data The initial extended state.
+         */
+        explicit StateMachine(State initial, Data data = Data()) : current(initial), extended(data) {
+            if (Def::entry[index(initial)]) {
+                Def::entry[index(initial)](extended);
+            }
+        }
+
+        /**
+         * Dispatches an event.
+         * @param event The event.
+         * @return True if a row was taken, false if the event was ignored.
+         */
+        bool dispatch(Event event) {
+            const Cell& cell = cells[index(current) * Def::EVENTS + static_cast<size_t>(event)];
+            for (size_t i = cell.first; i < static_cast<size_t>(cell.first) + cell.count; i++) {
+                const auto& row = Def::table[i];
+                if (row.guard && !row.guard(extended)) continue;
+                bool external = row.to != current;
+                if (external && Def::exit[index(current)]) {
+                    Def::exit[index(current)](extended);
+                }
+                if (row.action) {
+                    row.action(extended);
+                }
+                if (external) {
+                    current = row.to;
+                    if (Def::entry[index(current)]) {
+                        Def::entry[index(current)](extended);
+                    }
+                }
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @return The current state.
+         */
+        State state() const {
+            return current;
+        }
+
+        /**
+         * @return The extended state.
+         */
+        Data& data() {
+            return extended;
+        }
+
+    private:
+        static constexpr std::array<Cell, Def::STATES * Def::EVENTS> cells = buildJumpTable<Def>();
+
+        static constexpr size_t index(State state) {
+            return static_cast<size_t>(state);
+        }
+
+        State current; // Current state
+        Data extended; // Extended state
+    };
+}
+
+#endif
@@ -0,0 +1,242 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light logger
+*/
+
+#include "logger.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+/**
+ * @return The process-wide logger, started on first use.
+ */
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+/**
+ * Constructs the Logger and starts its thread.
+ */
+Logger::Logger()
+    : formatCount(0), cachedNs(0), dropped(0), passes(0), running(true), enabled(true), start(std::chrono::steady_clock::now()),
+      wallStart(std::chrono::system_clock::now()), cachedSecond(-1) {
+    cachedText[0] = '\0';
+    writerThread = std::thread(&Logger::writerLoop, this);
+}
+
+/**
+ * Stops the logger thread after writing every queued record.
+ */
+Logger::~Logger() {
+    running = false;
+    if (writerThread.joinable()) {
+        writerThread.join();
+    }
+    // Threads still alive will mark their ring closed when they exit, so those rings must outlive the logger
+    for (auto& ring : rings) {
+        if (!ring->closed.load()) {
+            ring.release();
+        }
+    }
+}
+
+/**
+ * Register a message format. Registering the same text again returns the same ID.
+ * @param format The message text with one "{}" per argument.
+ * @return The message ID.
+ */
+uint16_t Logger::intern(const char* format) {
+    std::lock_guard<std::mutex> lock(mtx);
+    size_t count = formatCount.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(formats[i], format) == 0) {
+            return static_cast<uint16_t>(i);
+        }
+    }
+    if (count == MAX_MESSAGES) {
+        std::cerr << "Logger: too many interned messages" << std::endl;
+        return 0;
+    }
+    formats[count] = format;
+    formatCount.store(count + 1, std::memory_order_release);
+    return static_cast<uint16_t>(count);
+}
+
+/**
+ * Mark the ring closed so the logger thread frees it once drained.
+ */
+Logger::RingHandle::~RingHandle() {
+    if (ring) {
+        ring->closed.store(true, std::memory_order_release);
+    }
+}
+
+/**
+ * @return The calling thread's ring, registering it on first use.
+ */
+Logger::Ring& Logger::localRing() {
+    thread_local RingHandle handle;
+    if (!handle.ring) {
+        std::unique_ptr<Ring> ring(new Ring());
+        handle.ring = ring.get();
+        std::lock_guard<std::mutex> lock(mtx);
+        rings.push_back(std::move(ring));
+    }
+    return *handle.ring;
+}
+
+/**
+ * Record a message in the calling thread's ring.
+ * @param message The message ID returned by intern.
+ * @param first The first argument.
+ * @param second The second argument.
+ */
+void Logger::log(uint16_t message, LogArg first, LogArg second) {
+    if (!enabled.load(std::memory_order_relaxed)) return;
+    Ring& ring = localRing();
+    size_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail - ring.head.load(std::memory_order_acquire) == RING_CAPACITY) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Record& record = ring.records[tail & (RING_CAPACITY - 1)];
+    record.timestampNs = cachedNs.load(std::memory_order_relaxed);
+    record.message = message;
+    record.args[0] = first;
+    record.args[1] = second;
+    ring.tail.store(tail + 1, std::memory_order_release);
+}
+
+/**
+ * Wait until every record logged before the call has been written.
+ */
+void Logger::flush() {
+    // The pass after the one in progress started after this call, so it collects everything
+    uint64_t target = passes.load() + 2;
+    while (passes.load() < target && running) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+/**
+ * @return The number of records dropped because a thread's ring was full.
+ */
+uint64_t Logger::droppedCount() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ * Turn logging on or off.
+ * @param enabled True to record messages.
+ */
+void Logger::setEnabled(bool enabled) {
+    this->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * Move every published record into a batch and free the rings of exited threads.
+ * @param batch Output vector the records are appended to.
+ */
+void Logger::collect(std::vector<Record>& batch) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (size_t i = 0; i < rings.size();) {
+        Ring& ring = *rings[i];
+        bool closed = ring.closed.load(std::memory_order_acquire);
+        size_t head = ring.head.load(std::memory_order_relaxed);
+        size_t tail = ring.tail.load(std::memory_order_acquire);
+        for (; head != tail; head++) {
+            batch.push_back(ring.records[head & (RING_CAPACITY - 1)]);
+        }
+        ring.head.store(head, std::memory_order_release);
+        if (closed) {
+            rings[i] = std::move(rings.back());
+            rings.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+/**
+ * Format one record as "[YYYY-MM-DD HH:MM:SS] message".
+ * @param record The record to format.
+ * @param out The text buffer the record is appended to.
+ */
+void Logger::format(const Record& record, std::string& out) {
+    auto wall = wallStart + std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(record.timestampNs));
+    time_t second = std::chrono::system_clock::to_time_t(wall);
+    if (second != cachedSecond) {
+        tm local;
+        localtime_r(&second, &local);
+        strftime(cachedText, sizeof(cachedText), "[%Y-%m-%d %H:%M:%S] ", &local);
+        cachedSecond = second;
+    }
+    out += cachedText;
+
+    const char* text = record.message < formatCount.load(std::memory_order_acquire) ? formats[record.message] : "?";
+    size_t arg = 0;
+    for (const char* c = text; *c; c++) {
+        if (c[0] == '{' && c[1] == '}' && arg < MAX_ARGS) {
+            const LogArg& value = record.args[arg++];
+            if (value.kind == LogArg::TEXT) {
+                out += value.text;
+            } else if (value.kind == LogArg::INTEGER) {
+                out += std::to_string(value.integer);
+            }
+            c++;
+        } else {
+            out += *c;
+        }
+    }
+    out += '\n';
+}
+
+/**
+ * Logger thread: refresh the cached clock, then collect, order, format and write records until
+ * the logger stops and nothing is left.
+ */
+void Logger::writerLoop() {
+    std::vector<Record> batch;
+    std::string out;
+    for (;;) {
+        bool stopping = !running;
+        cachedNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(),
+                       std::memory_order_relaxed);
+        collect(batch);
+        // Each ring is in order already; a stable sort interleaves the threads by time
+        std::stable_sort(batch.begin(), batch.end(), [](const Record& a, const Record& b) { return a.timestampNs < b.timestampNs; });
+        for (const Record& record : batch) {
+            format(record, out);
+        }
+        if (!out.empty()) {
+            std::cout.write(out.data(), out.size());
+            std::cout.flush();
+        }
+        bool idle = batch.empty();
+        batch.clear();
+        out.clear();
+        passes.fetch_add(1);
+        if (stopping) break;
+        if (idle) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    uint64_t lost = dropped.load();
+    if (lost > 0) {
+        std::cout << "[" << lost << " log records dropped]" << std::endl;
+    }
+}
+
+/**
+ * Log a message through the process-wide logger.
+ * @param message The message ID returned by Logger::intern.
+ * @param first The first argument.
+ * @param second The second argument.
+ */
+void logMessage(uint16_t message, LogArg first, LogArg second) {
+    Logger::instance().log(message, first, second);
+}
@@ -0,0 +1,176 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light logger
+*/
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * One argument of a log record: a static string or an integer.
+ */
+struct LogArg {
+    enum Kind : uint8_t { NONE, TEXT, INTEGER };
+
+    Kind kind;
+    union {
+        const char* text; // Must outlive the logger, e.g. a string literal
+        int64_t integer;
+    };
+
+    LogArg() : kind(NONE), integer(0) {}
+    LogArg(const char* text) : kind(TEXT), text(text) {}
+    LogArg(int value) : kind(INTEGER), integer(value) {}
+    LogArg(int64_t value) : kind(INTEGER), integer(value) {}
+    LogArg(uint64_t value) : kind(INTEGER), integer(static_cast<int64_t>(value)) {}
+};
+
+/**
+ * Asynchronous logger for the state machine.
+ *
+ * Messages are interned once into a table of formats with "{}" placeholders, so a log call only
+ * records a fixed-size entry: a timestamp read from a clock the logger thread keeps cached, the
+ * message ID and up to two arguments. Each thread writes its entries into a ring of its own,
+ * so logging threads never contend. A background thread collects the rings, orders the
+ * entries by time, formats them and writes them in batches. Entries are dropped and counted
+ * if a thread's ring is full.
+ */
+class Logger {
+public:
+    static const size_t MAX_ARGS = 2;         // Arguments per record
+    static const size_t MAX_MESSAGES = 256;   // Interned formats
+    static const size_t RING_CAPACITY = 1024; // Records per thread, a power of two
+
+    /**
+     * @return The process-wide logger, started on first use.
+     */
+    static Logger& instance();
+
+    /**
+     * Stops the logger thread after writing every queued record.
+     */
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    /**
+     * Registers a message format. Call once per message, e.g. from a function-local static.
+     * @param format The message text with one "{}" per argument. Must outlive the logger.
+     * @return The message ID.
+     */
+    uint16_t intern(const char* format);
+
+    /**
+     * Records a message. Never blocks.
+     * @param message The message ID returned by intern.
+     * @param first The first argument.
+     * @param second The second argument.
+     */
+    void log(uint16_t message, LogArg first = LogArg(), LogArg second = LogArg());
+
+    /**
+     * Waits until every record logged before the call has been written.
+     */
+    void flush();
+
+    /**
+     * @return The number of records dropped because a thread's ring was full.
+     */
+    uint64_t droppedCount() const;
+
+    /**
+     * Turns logging on or off. While off, log calls return at once; simulations use this to
+     * run many contexts without formatting their output.
+     * @param enabled True to record messages.
+     */
+    void setEnabled(bool enabled);
+
+private:
+    struct Record {
+        uint64_t timestampNs;   // Cached steady clock reading
+        uint16_t message;       // Interned message ID
+        LogArg args[MAX_ARGS];  // Arguments
+    };
+
+    /**
+     * Single-producer, single-consumer ring owned by one logging thread.
+     */
+    struct Ring {
+        Record records[RING_CAPACITY];
+        alignas(64) std::atomic<size_t> head;  // Next record the logger thread reads
+        alignas(64) std::atomic<size_t> tail;  // Next record the owning thread writes
+        std::atomic<bool> closed;              // Owning thread has exited
+
+        Ring() : head(0), tail(0), closed(false) {}
+    };
+
+    /**
+     * Marks the calling thread's ring closed when the thread exits.
+     */
+    struct RingHandle {
+        Ring* ring = nullptr;
+        ~RingHandle();
+    };
+
+    Logger();
+
+    /**
+     * @return The calling thread's ring, registering it on first use.
+     */
+    Ring& localRing();
+
+    /**
+     * Logger thread: refreshes the cached clock and writes batches of records.
+     */
+    void writerLoop();
+
+    /**
+     * Moves every published record into a batch and frees the rings of exited threads.
+     * @param batch Output vector the records are appended to.
+     */
+    void collect(std::vector<Record>& batch);
+
+    /**
+     * Formats one record.
+     * @param record The record to format.
+     * @param out The text buffer the record is appended to.
+     */
+    void format(const Record& record, std::string& out);
+
+    std::mutex mtx;                                 // Guards rings and interning
+    std::vector<std::unique_ptr<Ring>> rings;       // One per logging thread
+    const char* formats[MAX_MESSAGES];              // Interned formats, indexed by message ID
+    std::atomic<size_t> formatCount;                // Number of interned formats
+    std::atomic<uint64_t> cachedNs;                 // Steady clock reading refreshed by the logger thread
+    std::atomic<uint64_t> dropped;                  // Records lost to full rings
+    std::atomic<uint64_t> passes;                   // Completed collect-and-write passes
+    std::atomic<bool> running;                      // Flag to run the logger thread
+    std::atomic<bool> enabled;                      // Whether log calls record messages
+    std::chrono::steady_clock::time_point start;    // Reference point for timestamps
+    std::chrono::system_clock::time_point wallStart; // Wall clock time at start
+    time_t cachedSecond;                            // Second the cached timestamp text is for
+    char cachedText[32];                            // "[YYYY-MM-DD HH:MM:SS] " for cachedSecond
+    std::thread writerThread;                       // Thread formatting and writing records
+};
+
+/**
+ * Logs a message through the process-wide logger.
+ * @param message The message ID returned by Logger::intern.
+ * @param first The first argument.
+ * @param second The second argument.
+ */
+void logMessage(uint16_t message, LogArg first = LogArg(), LogArg second = LogArg());
+
+#endif
@@ -10,26 +10,113 @@ Title: Assignment 3
 
 #include "main.h"
 
+namespace {
+    /**
+     * IDs of the state machine's log messages, interned on first use.
+     */
+    struct Messages {
+        uint16_t transition = Logger::instance().intern("STATE TRANSITION: {} -> {}");
+        uint16_t initialState = Logger::instance().intern("INITIAL STATE: {}");
+        uint16_t restoredState = Logger::instance().intern("RESTORED STATE: {}");
+        uint16_t timerExpiry = Logger::instance().intern("PROCESSING: Timer expiry event");
+        uint16_t pedestrianButton = Logger::instance().intern("PROCESSING: Pedestrian button event");
+        uint16_t vehicleSensor = Logger::instance().intern("PROCESSING: Vehicle sensor event ({} vehicles on approach {})");
+        uint16_t emergencyStart = Logger::instance().intern("PROCESSING: Emergency preemption from approach {}");
+        uint16_t emergencyEnd = Logger::instance().intern("PROCESSING: Emergency preemption released on approach {}");
+        uint16_t vehicleSignal = Logger::instance().intern("SIGNAL -> Vehicles: {}");
+        uint16_t pedestrianSignal = Logger::instance().intern("SIGNAL -> Pedestrians: {}");
+    };
+
+    const Messages& messages() {
+        static const Messages ids;
+        return ids;
+    }
+}
+
 /**
- * Get the current timestamp as a string.
- * @return std::string representing the current timestamp in the format "YYYY-MM-DD HH:MM:SS".
+ * Merge rules for events queued back to back. A button press only sets the pedestrian waiting
+ * flag, so a press of the same crosswalk right after another changes nothing. Back-to-back
+ * sensor reports of one approach add up. Every timeout drives the cycle and every preemption
+ * change matters, so those are never merged.
+ * @param previous The earlier event; updated if the merge combines the payloads.
+ * @param next The event directly after it.
+ * @return True if next was merged into previous and must not be dispatched on its own.
  */
-std::string getCurrentTimestamp() {
-    auto now = std::chrono::system_clock::now();
-    auto time = std::chrono::system_clock::to_time_t(now);
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+bool coalesceEvents(EventRecord& previous, const EventRecord& next) {
+    switch (next.event()) {
+        case Event::PEDESTRIAN_BUTTON: {
+            PedestrianButtonPayload earlier, later;
+            return previous.get(earlier) && next.get(later) && earlier.crosswalk == later.crosswalk;
+        }
+        case Event::VEHICLE_SENSOR: {
+            VehicleSensorPayload earlier, later;
+            if (!previous.get(earlier) || !next.get(later) || earlier.approach != later.approach) return false;
+            uint32_t total = uint32_t(earlier.count) + later.count;
+            earlier.count = static_cast<uint16_t>(total < UINT16_MAX ? total : UINT16_MAX);
+            previous = EventRecord(earlier);
+            return true;
+        }
+        case Event::TIMEOUT:
+        case Event::EMERGENCY_PREEMPTION:
+            return false;
+    }
+    return false;
 }
 
 /**
- * Log a message with a timestamp.
- * @param message The message to log.
+ * Get the name of a state.
+ * @param id The state.
+ * @return The name of the state, or "NO_STATE" for StateId::NONE.
  */
-void logMessage(const std::string& message) {
-    static std::mutex logMutex;
-    std::lock_guard<std::mutex> lock(logMutex);
-    std::cout << "[" << getCurrentTimestamp() << "] " << message << std::endl;
+const char* stateName(StateId id) {
+    static const char* const names[] = { "NO_STATE", "VehiclesGreen", "VehiclesYellow", "PedestriansWalk", "PedestriansFlash" };
+    static_assert(sizeof(names) / sizeof(names[0]) == STATE_COUNT, "state name table out of date");
+    size_t index = static_cast<size_t>(id);
+    return index < sizeof(names) / sizeof(names[0]) ? names[index] : "UNKNOWN";
+}
+
+/**
+ * Default VEHICLE_SENSOR handler: the fixed-time cycle ignores sensors.
+ * @param sensor The sensor report.
+ * @return This state.
+ */
+State* State::vehicleDetected(Context*, const VehicleSensorPayload&) {
+    return this;
+}
+
+/**
+ * Default EMERGENCY_PREEMPTION handler: no preemption.
+ * @param preemption The preemption request.
+ * @return This state.
+ */
+State* State::emergencyPreemption(Context*, const EmergencyPreemptionPayload&) {
+    return this;
+}
+
+/**
+ * Dispatch an event to the handler for its type, unpacking its payload.
+ * @param context The context of the state machine.
+ * @param event The event and its payload.
+ * @return The next state.
+ */
+State* State::handle(Context* context, const EventRecord& event) {
+    switch (event.event()) {
+        case Event::TIMEOUT:
+            return timeout(context);
+        case Event::PEDESTRIAN_BUTTON:
+            return pedestrianWaiting(context);
+        case Event::VEHICLE_SENSOR: {
+            VehicleSensorPayload sensor;
+            event.get(sensor);
+            return vehicleDetected(context, sensor);
+        }
+        case Event::EMERGENCY_PREEMPTION: {
+            EmergencyPreemptionPayload preemption;
+            event.get(preemption);
+            return emergencyPreemption(context, preemption);
+        }
+    }
+    return this;
 }
 
 /**
@@ -38,97 +125,353 @@ void logMessage(const std::string& message) {
  *
  * The context maintains the current state and handles events and transitions.
  */
-Context::Context() : isPedestrianWaiting(false), running(true) {
+Context::Context(Clock& clock)
+    : clock(clock), executor(nullptr), currentState(nullptr), isPedestrianWaiting(false), flashCounter(0), running(true),
+      pendingEvents(0), scheduled(false), activeTimer(0), timerGeneration(0), staleTimeouts(0), publishedState(0), coalescedEvents(0),
+      processedEvents(0), stateEnteredAt(0), pedestrianPressedAt(NO_PRESS),
+      timerDeadline(0), checkpointFile(nullptr), checkpointSlot(0) {
+    clock.attach(this);
     eventThread = std::thread(&Context::processEvents, this);
 }
 
 /**
- * Destructor for the Context class. Stops the event processing thread.
+ * Constructs a Context whose events are processed on a shared executor instead of a thread of
+ * its own. Events are still processed one at a time, in order.
+ */
+Context::Context(Clock& clock, Executor& executor)
+    : clock(clock), executor(&executor), currentState(nullptr), isPedestrianWaiting(false), flashCounter(0), running(true),
+      pendingEvents(0), scheduled(false), activeTimer(0), timerGeneration(0), staleTimeouts(0), publishedState(0), coalescedEvents(0),
+      processedEvents(0), stateEnteredAt(0), pedestrianPressedAt(NO_PRESS),
+      timerDeadline(0), checkpointFile(nullptr), checkpointSlot(0) {
+    clock.attach(this);
+}
+
+/**
+ * Destructor for the Context class. Stops the event processing thread and cancels the pending
+ * timer, waiting for any delivery already in flight so the timer never touches freed memory.
  */
 Context::~Context() {
-    running = false;
-    cv.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = false;
+    }
+    // Stop timer deliveries first: once running is false a late delivery cannot submit the mailbox
+    clock.detach(this);
+    cancelTimer();
+    clock.synchronize();
+    {
+        // A scheduled mailbox still holds a pointer to this context on the executor
+        std::unique_lock<std::mutex> lock(mtx);
+        idleCv.wait(lock, [this]() { return !scheduled; });
+    }
+    eventQueue.wake();
+    idleCv.notify_all();
     if (eventThread.joinable()) {
         eventThread.join();
     }
+    // A batch that was still dispatching may have started another timer
+    cancelTimer();
+    clock.synchronize();
 }
 
 /**
  * Set the current state of the state machine.
  * @param state The new state.
  */
-void Context::setState(std::shared_ptr<State> state) {
+void Context::setState(State* state) {
     std::lock_guard<std::mutex> lock(mtx);
     if (currentState) {
-        logMessage("STATE TRANSITION: " + currentState->getName() + " -> " + state->getName());
+        logMessage(messages().transition, currentState->getName(), state->getName());
         currentState->exit(this);
     } else {
-        logMessage("INITIAL STATE: " + state->getName());
+        logMessage(messages().initialState, state->getName());
     }
-    currentState = state;
+    // Timers belong to the state that started them
+    cancelTimer();
+    uint64_t now = clock.now();
+    if (currentState) {
+        dwellMs[static_cast<size_t>(currentState->getId())].record(now - stateEnteredAt.load(std::memory_order_relaxed));
+    }
+    stateEnteredAt.store(now, std::memory_order_relaxed);
+    if (state->getId() == StateId::PEDESTRIANS_WALK) {
+        uint64_t pressed = pedestrianPressedAt.exchange(NO_PRESS, std::memory_order_relaxed);
+        if (pressed != NO_PRESS) {
+            pedestrianWaitMs.record(now - pressed);
+        }
+    }
+    publishState(state);
     currentState->entry(this);
+    checkpoint();
+}
+
+/**
+ * Make a state current and publish it to observers. The caller holds mtx.
+ * @param state The new state.
+ */
+void Context::publishState(State* state) {
+    currentState = state;
+    // Only callers holding mtx write the word, so a plain increment of the sequence is enough
+    uint64_t sequence = (publishedState.load(std::memory_order_relaxed) >> 8) + 1;
+    publishedState.store(sequence << 8 | static_cast<uint8_t>(state->getId()), std::memory_order_release);
+}
+
+/**
+ * Attach a checkpoint slot; the context is written to it after every event and state change.
+ * @param file The checkpoint file.
+ * @param slot The context's slot in the file.
+ */
+void Context::attachCheckpoint(CheckpointFile& file, size_t slot) {
+    std::lock_guard<std::mutex> lock(mtx);
+    checkpointFile = &file;
+    checkpointSlot = slot;
+}
+
+/**
+ * Write the context to its checkpoint slot. Only the thread processing events and setState
+ * call this, so the slot has one writer at a time.
+ */
+void Context::checkpoint() {
+    if (!checkpointFile) return;
+    CheckpointRecord record;
+    record.state = static_cast<uint8_t>(getCurrentStateId());
+    record.pedestrianWaiting = isPedestrianWaiting;
+    record.flashCounter = flashCounter;
+    record.timerPending = activeTimer.load() != 0;
+    uint64_t now = clock.now();
+    uint64_t deadline = timerDeadline.load(std::memory_order_relaxed);
+    record.remainingMs = record.timerPending && deadline > now ? deadline - now : 0;
+    record.wallTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    checkpointFile->write(checkpointSlot, record);
 }
 
 /**
- * Queue an event for processing.
+ * Resume the state saved in the checkpoint slot without running entry actions. The pending
+ * timer is restarted with the time it had left, less the wall clock time since the checkpoint.
+ * @return False if there is no checkpoint file or the slot holds no state.
+ */
+bool Context::restoreCheckpoint() {
+    std::lock_guard<std::mutex> lock(mtx);
+    CheckpointRecord record;
+    if (!checkpointFile || !checkpointFile->read(checkpointSlot, record)) return false;
+    State* state = stateForId(static_cast<StateId>(record.state));
+    if (!state) return false;
+
+    logMessage(messages().restoredState, state->getName());
+    cancelTimer();
+    isPedestrianWaiting = record.pedestrianWaiting;
+    flashCounter = record.flashCounter;
+    stateEnteredAt.store(clock.now(), std::memory_order_relaxed);
+    publishState(state);
+    if (record.timerPending) {
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        uint64_t elapsed = now > record.wallTimeMs ? static_cast<uint64_t>(now - record.wallTimeMs) : 0;
+        uint64_t remaining = record.remainingMs > elapsed ? record.remainingMs - elapsed : 0;
+        startTimer(std::chrono::milliseconds(remaining));
+    }
+    checkpoint();
+    return true;
+}
+
+/**
+ * Queue an event for processing. Never waits for the state machine: the event goes into the
+ * lock-free queue and the event thread is woken only if it is parked. Events queued once the
+ * context is being destroyed are dropped.
  * @param event The event to queue.
  */
-void Context::queueEvent(Event event) {
-    {
-        std::lock_guard<std::mutex> lock(mtx);
-        eventQueue.push(event);
+void Context::queueEvent(const EventRecord& event) {
+    if (!running) {
+        return;
+    }
+    pendingEvents.fetch_add(1);
+    eventQueue.push(event);
+    if (executor && !scheduled.exchange(true)) {
+        executor->submit(this);
     }
-    cv.notify_one();
 }
 
 /**
- * Process events from the event queue.
+ * Process events from the event queue on the context's own thread.
  */
 void Context::processEvents() {
+    EventRecord batch[MAILBOX_BATCH];
     while (running) {
-        std::unique_lock<std::mutex> lock(mtx);
-        cv.wait(lock, [this]() { return !eventQueue.empty() || !running; });
-
-        if (!running) break;
-
-        if (!eventQueue.empty()) {
-            Event event = eventQueue.front();
-            eventQueue.pop();
-            lock.unlock();
-
-            if (currentState) {
-                std::shared_ptr<State> newState;
-                switch (event) {
-                    case Event::TIMEOUT:
-                        logMessage("PROCESSING: Timer expiry event");
-                        newState = currentState->timeout(this);
-                        break;
-                    case Event::PEDESTRIAN_BUTTON:
-                        isPedestrianWaiting = true;
-                        logMessage("PROCESSING: Pedestrian button event");
-                        newState = currentState->pedestrianWaiting(this);
-                        break;
-                }
-                if (newState && newState != currentState) {
-                    setState(newState);
-                }
+        size_t depth = pendingEvents.load(std::memory_order_relaxed);
+        size_t count = drainBatch(batch, MAILBOX_BATCH);
+        if (count == 0) {
+            eventQueue.park([this]() { return !running; });
+            continue;
+        }
+        dispatchBatch(batch, count, depth);
+    }
+}
+
+/**
+ * Run the mailbox on an executor thread. At most MAILBOX_BATCH events are processed per run so
+ * one busy context cannot monopolize a worker; if more are waiting, the context resubmits itself.
+ */
+void Context::run() {
+    EventRecord batch[MAILBOX_BATCH];
+    size_t depth = pendingEvents.load(std::memory_order_relaxed);
+    size_t count = running ? drainBatch(batch, MAILBOX_BATCH) : 0;
+    if (count > 0) {
+        dispatchBatch(batch, count, depth);
+    }
+    bool resubmit;
+    {
+        // The destructor waits for scheduled to clear under this lock, so nothing below the
+        // lock may touch the context unless the mailbox stays scheduled
+        std::lock_guard<std::mutex> lock(mtx);
+        scheduled.store(false);
+        resubmit = running && !eventQueue.empty() && !scheduled.exchange(true);
+        if (!resubmit) {
+            idleCv.notify_all();
+        }
+    }
+    if (resubmit) {
+        executor->submit(this);
+    }
+}
+
+/**
+ * Take up to a batch of queued events. An idempotent event directly following an identical one
+ * is dropped and counted as coalesced; the event it merged into is still pending, so the pending
+ * count cannot reach zero before that one is dispatched.
+ * @param batch Receives the events to dispatch.
+ * @param capacity The number of events batch can hold.
+ * @return The number of events stored in batch.
+ */
+size_t Context::drainBatch(EventRecord* batch, size_t capacity) {
+    size_t count = 0;
+    EventRecord queued;
+    while (count < capacity && eventQueue.pop(queued)) {
+        if (count > 0 && coalesceEvents(batch[count - 1], queued)) {
+            coalescedEvents.fetch_add(1, std::memory_order_relaxed);
+            eventProcessed();
+            continue;
+        }
+        batch[count++] = queued;
+    }
+    return count;
+}
+
+/**
+ * Dispatch a drained batch and update the event metrics.
+ * @param batch The events to dispatch.
+ * @param count The number of events in batch.
+ * @param depth The number of pending events when the batch was drained.
+ */
+void Context::dispatchBatch(const EventRecord* batch, size_t count, size_t depth) {
+    queueDepth.record(depth);
+    processedEvents.fetch_add(count, std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        dispatch(batch[i]);
+        eventProcessed();
+    }
+}
+
+/**
+ * Count a processed event and wake waitUntilIdle callers when it was the last one.
+ */
+void Context::eventProcessed() {
+    if (pendingEvents.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(mtx);
+        idleCv.notify_all();
+    }
+}
+
+/**
+ * Dispatch one event to the current state and perform the transition it returns.
+ * @param event The event to dispatch.
+ */
+void Context::dispatch(const EventRecord& event) {
+    TimeoutPayload timeout;
+    if (event.get(timeout) && timeout.generation != timerGeneration) {
+        // The timer was cancelled or replaced after this timeout was queued
+        staleTimeouts++;
+        return;
+    }
+    if (!currentState) return;
+    switch (event.event()) {
+        case Event::TIMEOUT:
+            logMessage(messages().timerExpiry);
+            break;
+        case Event::PEDESTRIAN_BUTTON:
+            if (pedestrianPressedAt.load(std::memory_order_relaxed) == NO_PRESS) {
+                pedestrianPressedAt.store(clock.now(), std::memory_order_relaxed);
             }
+            isPedestrianWaiting = true;
+            logMessage(messages().pedestrianButton);
+            break;
+        case Event::VEHICLE_SENSOR: {
+            VehicleSensorPayload sensor;
+            event.get(sensor);
+            logMessage(messages().vehicleSensor, sensor.count, sensor.approach);
+            break;
+        }
+        case Event::EMERGENCY_PREEMPTION: {
+            EmergencyPreemptionPayload preemption;
+            event.get(preemption);
+            logMessage(preemption.active ? messages().emergencyStart : messages().emergencyEnd, preemption.approach);
+            break;
         }
     }
+    State* newState = currentState->handle(this, event);
+    if (newState && newState != currentState) {
+        setState(newState);
+    } else {
+        checkpoint();
+    }
+}
+
+/**
+ * Wait until every queued event has been processed.
+ */
+void Context::waitUntilIdle() {
+    std::unique_lock<std::mutex> lock(mtx);
+    idleCv.wait(lock, [this]() { return pendingEvents == 0 || !running; });
 }
 
 /**
- * Queue a TIMEOUT event.
+ * Queue a TIMEOUT event for the pending timer.
  */
 void Context::timeout() {
-    queueEvent(Event::TIMEOUT);
+    queueEvent(TimeoutPayload{timerGeneration});
+}
+
+/**
+ * Queue a TIMEOUT event for an expired timer.
+ * @param generation The generation the timer was started under.
+ */
+void Context::timerExpired(uint64_t generation) {
+    queueEvent(TimeoutPayload{generation});
 }
 
 /**
  * Queue a PEDESTRIAN_BUTTON event.
+ * @param crosswalk The crosswalk whose button was pressed.
  */
-void Context::pedestrianWaiting() {
-    queueEvent(Event::PEDESTRIAN_BUTTON);
+void Context::pedestrianWaiting(uint8_t crosswalk) {
+    queueEvent(PedestrianButtonPayload{crosswalk});
+}
+
+/**
+ * Queue a VEHICLE_SENSOR event.
+ * @param approach The approach the sensor watches.
+ * @param count The number of vehicles detected since the last report.
+ */
+void Context::vehicleDetected(uint8_t approach, uint16_t count) {
+    queueEvent(VehicleSensorPayload{approach, count});
+}
+
+/**
+ * Queue an EMERGENCY_PREEMPTION event.
+ * @param approach The approach the emergency vehicle is coming from.
+ * @param active True when preemption starts, false when it is released.
+ */
+void Context::emergencyPreemption(uint8_t approach, bool active) {
+    queueEvent(EmergencyPreemptionPayload{approach, active});
 }
 
 /**
@@ -139,6 +482,22 @@ void Context::setIsPedestrianWaiting(bool value) {
     isPedestrianWaiting = value;
 }
 
+/**
+ * Set the number of flashes left in the PedestriansFlash state.
+ * @param value The number of flashes left.
+ */
+void Context::setFlashCounter(int value) {
+    flashCounter = value;
+}
+
+/**
+ * Get the number of flashes left in the PedestriansFlash state.
+ * @return The number of flashes left.
+ */
+int Context::getFlashCounter() const {
+    return flashCounter;
+}
+
 /**
  * Get the pedestrian waiting flag.
  * @return True if a pedestrian is waiting, false otherwise.
@@ -151,27 +510,114 @@ bool Context::getIsPedestrianWaiting() const {
  * Signal vehicles with a given signal.
  * @param signal The signal to display to vehicles.
  */
-void Context::signalVehicles(const std::string& signal) {
-    logMessage("SIGNAL -> Vehicles: " + signal);
+void Context::signalVehicles(const char* signal) {
+    logMessage(messages().vehicleSignal, signal);
 }
 
 /**
  * Signal pedestrians with a given signal.
  * @param signal The signal to display to pedestrians.
  */
-void Context::signalPedestrians(const std::string& signal) {
-    logMessage("SIGNAL -> Pedestrians: " + signal);
+void Context::signalPedestrians(const char* signal) {
+    logMessage(messages().pedestrianSignal, signal);
 }
 
 /**
  * Start a timer that triggers a TIMEOUT event after a given number of seconds.
+ * The timer is held by the context's clock rather than a thread of its own, and replaces
+ * any timer already pending for this context.
  * @param seconds The duration of the timer.
+ * @return The handle of the new timer.
  */
-void Context::startTimer(int seconds) {
-    std::thread([this, seconds]() {
-        std::this_thread::sleep_for(std::chrono::seconds(seconds));
-        timeout();
-    }).detach();
+TimerId Context::startTimer(int seconds) {
+    return startTimer(std::chrono::seconds(seconds));
+}
+
+/**
+ * Start a timer that triggers a TIMEOUT event after a delay, replacing any timer already pending.
+ * @param delay The time until the timer expires.
+ * @return The handle of the new timer.
+ */
+TimerId Context::startTimer(std::chrono::milliseconds delay) {
+    uint64_t generation = ++timerGeneration;
+    if (checkpointFile) {
+        // Only checkpoints need the deadline; reading the clock is not free
+        timerDeadline.store(clock.now() + delay.count(), std::memory_order_relaxed);
+    }
+    TimerId id = clock.schedule(this, delay, generation);
+    TimerId previous = activeTimer.exchange(id);
+    if (previous != 0) {
+        clock.cancel(previous);
+    }
+    return id;
+}
+
+/**
+ * Set the phase lengths used by the states' entry actions.
+ * @param timing The phase lengths.
+ */
+void Context::setTiming(const TimingConfig& timing) {
+    std::lock_guard<std::mutex> lock(mtx);
+    this->timing = timing;
+}
+
+/**
+ * Get the phase lengths used by the states' entry actions.
+ * @return The phase lengths.
+ */
+const TimingConfig& Context::getTiming() const {
+    return timing;
+}
+
+/**
+ * Cancel the pending timer, if any. Bumping the generation makes a timeout that is already
+ * queued stale, so it is discarded instead of driving a transition.
+ */
+void Context::cancelTimer() {
+    timerGeneration++;
+    TimerId id = activeTimer.exchange(0);
+    if (id != 0) {
+        clock.cancel(id);
+    }
+}
+
+/**
+ * Get the number of timeouts discarded because their timer had been cancelled or replaced.
+ * @return The number of stale timeouts.
+ */
+uint64_t Context::getStaleTimeoutCount() const {
+    return staleTimeouts;
+}
+
+/**
+ * Get the number of events coalesced into an identical event queued just before them.
+ * @return The number of coalesced events.
+ */
+uint64_t Context::getCoalescedEventCount() const {
+    return coalescedEvents.load(std::memory_order_relaxed);
+}
+
+/**
+ * Copy the context's counters and histograms without stopping event processing.
+ * @return The metrics.
+ */
+ContextMetrics Context::getMetrics() const {
+    ContextMetrics metrics;
+    StateSnapshot snapshot = getStateSnapshot();
+    metrics.timestampMs = clock.now();
+    metrics.state = snapshot.state;
+    uint64_t enteredAt = stateEnteredAt.load(std::memory_order_relaxed);
+    metrics.timeInStateMs = snapshot.state != StateId::NONE && metrics.timestampMs > enteredAt ? metrics.timestampMs - enteredAt : 0;
+    metrics.transitions = snapshot.sequence > 0 ? snapshot.sequence - 1 : 0;
+    metrics.eventsProcessed = processedEvents.load(std::memory_order_relaxed);
+    metrics.eventsCoalesced = coalescedEvents.load(std::memory_order_relaxed);
+    metrics.staleTimeouts = staleTimeouts.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < STATE_COUNT; i++) {
+        metrics.dwellMs[i] = dwellMs[i].snapshot();
+    }
+    metrics.pedestrianWaitMs = pedestrianWaitMs.snapshot();
+    metrics.queueDepth = queueDepth.snapshot();
+    return metrics;
 }
 
 /**
@@ -179,16 +625,50 @@ void Context::startTimer(int seconds) {
  * @return The name of the current state as a string, or "NO_STATE" if no state is set.
  */
 std::string Context::getCurrentStateName() const {
-    std::lock_guard<std::mutex> lock(mtx);
-    return currentState ? currentState->getName() : "NO_STATE";
+    return stateName(getCurrentStateId());
+}
+
+/**
+ * Get the current state without locking.
+ * @return The identifier of the current state.
+ */
+StateId Context::getCurrentStateId() const {
+    return static_cast<StateId>(publishedState.load(std::memory_order_acquire) & 0xff);
+}
+
+/**
+ * Get the current state and its transition sequence number without locking. Both come from
+ * a single atomic word, so they always belong together.
+ * @return The current state and the number of states entered so far.
+ */
+StateSnapshot Context::getStateSnapshot() const {
+    uint64_t word = publishedState.load(std::memory_order_acquire);
+    return StateSnapshot{ static_cast<StateId>(word & 0xff), word >> 8 };
+}
+
+/**
+ * Returns the shared instance of the state.
+ * @return The VehiclesGreen state.
+ */
+VehiclesGreen& VehiclesGreen::instance() {
+    static VehiclesGreen state;
+    return state;
 }
 
 /**
  * Returns the name of the state as a string.
  * @return The name of the state "VehiclesGreen".
  */
-std::string VehiclesGreen::getName() const {
-    return "VehiclesGreen";
+const char* VehiclesGreen::getName() const {
+    return stateName(StateId::VEHICLES_GREEN);
+}
+
+/**
+ * Returns the identifier of the state.
+ * @return StateId::VEHICLES_GREEN.
+ */
+StateId VehiclesGreen::getId() const {
+    return StateId::VEHICLES_GREEN;
 }
 
 /**
@@ -198,7 +678,7 @@ std::string VehiclesGreen::getName() const {
 void VehiclesGreen::entry(Context* context) {
     context->signalVehicles("GREEN");
     context->signalPedestrians("DONT_WALK");
-    context->startTimer(10);
+    context->startTimer(context->getTiming().green);
 }
 
 /**
@@ -212,31 +692,48 @@ void VehiclesGreen::exit(Context*) {}
  * @param context Pointer to the Context object managing the state.
  * @return The next state depending on whether a pedestrian is waiting.
  */
-std::shared_ptr<State> VehiclesGreen::timeout(Context* context) {
+State* VehiclesGreen::timeout(Context* context) {
     if (context->getIsPedestrianWaiting()) {
-        return std::shared_ptr<State>(new VehiclesYellow());
+        return &VehiclesYellow::instance();
     }
-    context->startTimer(10);
-    return shared_from_this();
+    context->startTimer(context->getTiming().green);
+    return this;
 }
 
 /**
  * Handles pedestrian waiting event. Does nothing and stays in the same state.
  * @param context Pointer to the Context object managing the state.
- * @return Shared pointer to the current state.
+ * @return Pointer to the current state.
  */
-std::shared_ptr<State> VehiclesGreen::pedestrianWaiting(Context*) {
-    return shared_from_this();
+State* VehiclesGreen::pedestrianWaiting(Context*) {
+    return this;
 }
 
 // VehiclesYellow Implementation
 
+/**
+ * Returns the shared instance of the state.
+ * @return The VehiclesYellow state.
+ */
+VehiclesYellow& VehiclesYellow::instance() {
+    static VehiclesYellow state;
+    return state;
+}
+
 /**
  * Returns the name of the state as a string.
  * @return The name of the state "VehiclesYellow".
  */
-std::string VehiclesYellow::getName() const {
-    return "VehiclesYellow";
+const char* VehiclesYellow::getName() const {
+    return stateName(StateId::VEHICLES_YELLOW);
+}
+
+/**
+ * Returns the identifier of the state.
+ * @return StateId::VEHICLES_YELLOW.
+ */
+StateId VehiclesYellow::getId() const {
+    return StateId::VEHICLES_YELLOW;
 }
 
 /**
@@ -246,7 +743,7 @@ std::string VehiclesYellow::getName() const {
 void VehiclesYellow::entry(Context* context) {
     context->signalVehicles("YELLOW");
     context->signalPedestrians("DONT_WALK");
-    context->startTimer(3);
+    context->startTimer(context->getTiming().yellow);
 }
 
 /**
@@ -260,27 +757,44 @@ void VehiclesYellow::exit(Context*) {}
  * @param context Pointer to the Context object managing the state.
  * @return The next state (PedestriansWalk).
  */
-std::shared_ptr<State> VehiclesYellow::timeout(Context*) {
-    return std::shared_ptr<State>(new PedestriansWalk());
+State* VehiclesYellow::timeout(Context*) {
+    return &PedestriansWalk::instance();
 }
 
 /**
  * Handles pedestrian waiting event. Does nothing and stays in the same state.
  * @param context Pointer to the Context object managing the state.
- * @return Shared pointer to the current state.
+ * @return Pointer to the current state.
  */
-std::shared_ptr<State> VehiclesYellow::pedestrianWaiting(Context*) {
-    return shared_from_this();
+State* VehiclesYellow::pedestrianWaiting(Context*) {
+    return this;
 }
 
 // PedestriansWalk Implementation
 
+/**
+ * Returns the shared instance of the state.
+ * @return The PedestriansWalk state.
+ */
+PedestriansWalk& PedestriansWalk::instance() {
+    static PedestriansWalk state;
+    return state;
+}
+
 /**
  * Returns the name of the state as a string.
  * @return The name of the state "PedestriansWalk".
  */
-std::string PedestriansWalk::getName() const {
-    return "PedestriansWalk";
+const char* PedestriansWalk::getName() const {
+    return stateName(StateId::PEDESTRIANS_WALK);
+}
+
+/**
+ * Returns the identifier of the state.
+ * @return StateId::PEDESTRIANS_WALK.
+ */
+StateId PedestriansWalk::getId() const {
+    return StateId::PEDESTRIANS_WALK;
 }
 
 /**
@@ -291,7 +805,7 @@ void PedestriansWalk::entry(Context* context) {
     context->signalVehicles("RED");
     context->signalPedestrians("WALK");
     context->setIsPedestrianWaiting(false);
-    context->startTimer(15);
+    context->startTimer(context->getTiming().walk);
 }
 
 /**
@@ -305,32 +819,44 @@ void PedestriansWalk::exit(Context*) {}
  * @param context Pointer to the Context object managing the state.
  * @return The next state (PedestriansFlash).
  */
-std::shared_ptr<State> PedestriansWalk::timeout(Context*) {
-    return std::shared_ptr<State>(new PedestriansFlash());
+State* PedestriansWalk::timeout(Context*) {
+    return &PedestriansFlash::instance();
 }
 
 /**
  * Handles pedestrian waiting event. Does nothing and stays in the same state.
  * @param context Pointer to the Context object managing the state.
- * @return Shared pointer to the current state.
+ * @return Pointer to the current state.
  */
-std::shared_ptr<State> PedestriansWalk::pedestrianWaiting(Context*) {
-    return shared_from_this();
+State* PedestriansWalk::pedestrianWaiting(Context*) {
+    return this;
 }
 
 // PedestriansFlash Implementation
 
 /**
- * Constructor for PedestriansFlash state. Initializes the flash counter.
+ * Returns the shared instance of the state.
+ * @return The PedestriansFlash state.
  */
-PedestriansFlash::PedestriansFlash() : flashCounter(7) {}
+PedestriansFlash& PedestriansFlash::instance() {
+    static PedestriansFlash state;
+    return state;
+}
 
 /**
  * Returns the name of the state as a string.
  * @return The name of the state "PedestriansFlash".
  */
-std::string PedestriansFlash::getName() const {
-    return "PedestriansFlash";
+const char* PedestriansFlash::getName() const {
+    return stateName(StateId::PEDESTRIANS_FLASH);
+}
+
+/**
+ * Returns the identifier of the state.
+ * @return StateId::PEDESTRIANS_FLASH.
+ */
+StateId PedestriansFlash::getId() const {
+    return StateId::PEDESTRIANS_FLASH;
 }
 
 /**
@@ -338,9 +864,9 @@ std::string PedestriansFlash::getName() const {
  * @param context Pointer to the Context object managing the state.
  */
 void PedestriansFlash::entry(Context* context) {
-    flashCounter = 7;
+    context->setFlashCounter(context->getTiming().flashes);
     handleFlash(context);
-    context->startTimer(1);
+    context->startTimer(context->getTiming().flash);
 }
 
 /**
@@ -354,25 +880,25 @@ void PedestriansFlash::exit(Context*) {}
  * @param context Pointer to the Context object managing the state.
  * @return The next state depending on the flash counter.
  */
-std::shared_ptr<State> PedestriansFlash::timeout(Context* context) {
-    flashCounter--;
+State* PedestriansFlash::timeout(Context* context) {
+    context->setFlashCounter(context->getFlashCounter() - 1);
 
-    if (flashCounter == 0) {
-        return std::shared_ptr<State>(new VehiclesGreen());
+    if (context->getFlashCounter() == 0) {
+        return &VehiclesGreen::instance();
     }
 
     handleFlash(context);
-    context->startTimer(1);
-    return shared_from_this();
+    context->startTimer(context->getTiming().flash);
+    return this;
 }
 
 /**
  * Handles pedestrian waiting event. Does nothing and stays in the same state.
  * @param context Pointer to the Context object managing the state.
- * @return Shared pointer to the current state.
+ * @return Pointer to the current state.
  */
-std::shared_ptr<State> PedestriansFlash::pedestrianWaiting(Context*) {
-    return shared_from_this();
+State* PedestriansFlash::pedestrianWaiting(Context*) {
+    return this;
 }
 
 /**
@@ -380,9 +906,30 @@ std::shared_ptr<State> PedestriansFlash::pedestrianWaiting(Context*) {
  * @param context Pointer to the Context object managing the state.
  */
 void PedestriansFlash::handleFlash(Context* context) {
-    if ((flashCounter & 1) == 0) {
+    if ((context->getFlashCounter() & 1) == 0) {
         context->signalPedestrians("DONT_WALK");
     } else {
         context->signalPedestrians("BLANK");
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Get the state with an identifier.
+ * @param id The state identifier.
+ * @return The shared instance of the state, or nullptr for StateId::NONE or an unknown identifier.
+ */
+State* stateForId(StateId id) {
+    switch (id) {
+        case StateId::VEHICLES_GREEN:
+            return &VehiclesGreen::instance();
+        case StateId::VEHICLES_YELLOW:
+            return &VehiclesYellow::instance();
+        case StateId::PEDESTRIANS_WALK:
+            return &PedestriansWalk::instance();
+        case StateId::PEDESTRIANS_FLASH:
+            return &PedestriansFlash::instance();
+        case StateId::NONE:
+            break;
+    }
+    return nullptr;
+}
@@ -18,35 +18,83 @@ Title: Assignment 3
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
-#include <queue>
-#include <ctime>
-#include <sstream>
-#include <iomanip>
+#include <string>
+
+#include "checkpoint.h"
+#include "clock.h"
+#include "event.h"
+#include "event_queue.h"
+#include "executor.h"
+#include "logger.h"
+#include "metrics.h"
 
 /**
- * Enumeration representing different types of events in the system.
+ * Compact identifier of a traffic light state, published for lock-free observers.
  */
-enum class Event { TIMEOUT, PEDESTRIAN_BUTTON };
+enum class StateId : uint8_t { NONE, VEHICLES_GREEN, VEHICLES_YELLOW, PEDESTRIANS_WALK, PEDESTRIANS_FLASH };
 
-class State;
-class Context;
+const size_t STATE_COUNT = 5; // Number of StateId values, NONE included
+
+/**
+ * Merge rules for events queued back to back.
+ * @param previous The earlier event; updated if the merge combines the payloads.
+ * @param next The event directly after it.
+ * @return True if next was merged into previous and must not be dispatched on its own.
+ */
+bool coalesceEvents(EventRecord& previous, const EventRecord& next);
+
+/**
+ * Get the name of a state.
+ * @param id The state.
+ * @return The name of the state, or "NO_STATE" for StateId::NONE.
+ */
+const char* stateName(StateId id);
 
 /**
- * Get the current timestamp as a string.
- * @return A string representing the current timestamp in the format [YYYY-MM-DD HH:MM:SS].
+ * The current state of a context as seen by an observer.
  */
-std::string getCurrentTimestamp();
+struct StateSnapshot {
+    StateId state;     // The current state
+    uint64_t sequence; // Number of states entered so far; changes on every transition
+};
 
 /**
- * Logs a message with a timestamp.
- * @param message The message to be logged.
+ * Counters and histograms of a context, copied at one point in time. Times are in clock milliseconds.
  */
-void logMessage(const std::string& message);
+struct ContextMetrics {
+    uint64_t timestampMs;                   // Clock time the snapshot was taken
+    StateId state;                          // The current state
+    uint64_t timeInStateMs;                 // Time spent in the current state so far
+    uint64_t transitions;                   // State changes, not counting the initial state
+    uint64_t eventsProcessed;               // Events dispatched to a state
+    uint64_t eventsCoalesced;               // Events merged into an identical event before them
+    uint64_t staleTimeouts;                 // Timeouts discarded because their timer was superseded
+    HistogramSnapshot dwellMs[STATE_COUNT]; // Length of each completed visit, indexed by StateId
+    HistogramSnapshot pedestrianWaitMs;     // Time from the first unanswered button press to WALK
+    HistogramSnapshot queueDepth;           // Events pending when the context starts a batch
+};
+
+/**
+ * Phase lengths of the traffic light cycle. The defaults are the original fixed timings.
+ */
+struct TimingConfig {
+    std::chrono::milliseconds green{10000};  // Vehicles green, restarted while no pedestrian waits
+    std::chrono::milliseconds yellow{3000};  // Vehicles yellow
+    std::chrono::milliseconds walk{15000};   // Pedestrians walk
+    std::chrono::milliseconds flash{1000};   // One pedestrian flash
+    int flashes = 7;                         // Flashes before vehicles get green again
+};
+
+class State;
+class Context;
 
 /**
  * Abstract base class representing a state in the traffic light system.
+ * States are stateless singletons; anything that varies per intersection lives in the Context.
+ * Because a state holds no per-context data, one instance serves every context and a transition
+ * never allocates.
  */
-class State : public std::enable_shared_from_this<State> {
+class State {
 public:
     virtual ~State() = default;
 
@@ -55,14 +103,38 @@ public:
      * @param context The context of the state machine.
      * @return The next state.
      */
-    virtual std::shared_ptr<State> timeout(Context* context) = 0;
+    virtual State* timeout(Context* context) = 0;
 
     /**
      * Handles the PEDESTRIAN_BUTTON event.
      * @param context The context of the state machine.
      * @return The next state.
      */
-    virtual std::shared_ptr<State> pedestrianWaiting(Context* context) = 0;
+    virtual State* pedestrianWaiting(Context* context) = 0;
+
+    /**
+     * Handles the VEHICLE_SENSOR event. Ignored unless a state overrides it.
+     * @param context The context of the state machine.
+     * @param sensor The sensor report.
+     * @return The next state.
+     */
+    virtual State* vehicleDetected(Context* context, const VehicleSensorPayload& sensor);
+
+    /**
+     * Handles the EMERGENCY_PREEMPTION event. Ignored unless a state overrides it.
+     * @param context The context of the state machine.
+     * @param preemption The preemption request.
+     * @return The next state.
+     */
+    virtual State* emergencyPreemption(Context* context, const EmergencyPreemptionPayload& preemption);
+
+    /**
+     * Dispatches an event to the handler for its type.
+     * @param context The context of the state machine.
+     * @param event The event and its payload.
+     * @return The next state.
+     */
+    virtual State* handle(Context* context, const EventRecord& event);
 
     /**
      * Entry action for the state.
@@ -80,44 +152,119 @@ public:
      * Get the name of the state.
      * @return The name of the state as a string.
      */
-    virtual std::string getName() const = 0;
+    virtual const char* getName() const = 0;
+
+    /**
+     * Get the identifier of the state.
+     * @return The identifier of the state.
+     */
+    virtual StateId getId() const = 0;
 };
 
 /**
  * Context class representing the state machine and traffic light system.
+ * Events are processed either on a thread owned by the context or, as an actor, on a shared
+ * Executor; in both cases one at a time and in the order they were queued.
  */
-class Context {
+class Context : public Task {
 private:
-    std::shared_ptr<State> currentState;
+    static const int MAILBOX_BATCH = 64;       // Events drained and dispatched per batch
+
+    Clock& clock;                              // Source of time and timers
+    Executor* executor;                        // Executor running the mailbox, nullptr for a dedicated thread
+    State* currentState;
     std::atomic<bool> isPedestrianWaiting;
+    int flashCounter;                          // Flashes left in PedestriansFlash
+    TimingConfig timing;                       // Phase lengths used by the entry actions
     mutable std::mutex mtx;
     std::atomic<bool> running;
-    std::queue<Event> eventQueue;
-    std::condition_variable cv;
+    EventQueue<EventRecord> eventQueue;        // Lock-free queue filled by any thread, drained by one
+    std::condition_variable idleCv;            // Signalled when the last queued event has been processed
+    std::atomic<size_t> pendingEvents;         // Events queued or being processed
+    std::atomic<bool> scheduled;               // Mailbox submitted to the executor; cleared under mtx
     std::thread eventThread;
+    std::atomic<TimerId> activeTimer;          // Handle of the pending timer, 0 if none
+    std::atomic<uint64_t> timerGeneration;     // Generation of the pending timer; older timeouts are stale
+    std::atomic<uint64_t> staleTimeouts;       // Timeouts discarded because their timer was superseded
+    std::atomic<uint64_t> publishedState;      // Sequence number << 8 | StateId of the current state
+    std::atomic<uint64_t> coalescedEvents;     // Events merged into an identical event queued just before them
+    std::atomic<uint64_t> processedEvents;     // Events dispatched to a state
+    std::atomic<uint64_t> stateEnteredAt;      // Clock time the current state was entered
+    std::atomic<uint64_t> pedestrianPressedAt; // Clock time of the first unanswered button press, NO_PRESS if none
+    Histogram dwellMs[STATE_COUNT];            // Length of each completed visit, indexed by StateId
+    Histogram pedestrianWaitMs;                // Time from the first unanswered button press to WALK
+    Histogram queueDepth;                      // Events pending when a batch starts
+
+    std::atomic<uint64_t> timerDeadline;       // Clock time the pending timer expires, kept while checkpointing
+    CheckpointFile* checkpointFile;            // File the context is checkpointed into, nullptr if none
+    size_t checkpointSlot;                     // Slot of the context in checkpointFile
+
+    static const uint64_t NO_PRESS = UINT64_MAX;
+
+    /**
+     * Counts a processed event and wakes waitUntilIdle callers when it was the last one.
+     */
+    void eventProcessed();
+
+    /**
+     * Takes up to a batch of queued events, merging events into the one directly before them
+     * where coalesceEvents allows it.
+     * @param batch Receives the events to dispatch.
+     * @param capacity The number of events batch can hold.
+     * @return The number of events stored in batch.
+     */
+    size_t drainBatch(EventRecord* batch, size_t capacity);
+
+    /**
+     * Dispatches a drained batch and updates the event metrics.
+     * @param batch The events to dispatch.
+     * @param count The number of events in batch.
+     * @param depth The number of pending events when the batch was drained.
+     */
+    void dispatchBatch(const EventRecord* batch, size_t count, size_t depth);
+
+    /**
+     * Makes a state current and publishes it to observers. The caller holds mtx.
+     * @param state The new state.
+     */
+    void publishState(State* state);
+
+    /**
+     * Writes the context to its checkpoint slot, if it has one.
+     */
+    void checkpoint();
 
 public:
     /**
      * Constructs a Context object and starts event processing.
+     * @param clock The clock that drives the context's timers.
+     */
+    explicit Context(Clock& clock = RealTimeClock::instance());
+
+    /**
+     * Constructs a Context that processes its events on a shared executor.
+     * The executor must outlive the context.
+     * @param clock The clock that drives the context's timers.
+     * @param executor The executor running the context's mailbox.
      */
-    Context();
+    Context(Clock& clock, Executor& executor);
 
     /**
      * Destructor to stop event processing and clean up resources.
      */
-    ~Context();
+    ~Context() override;
 
     /**
      * Sets the current state.
      * @param state The new state to transition to.
      */
-    void setState(std::shared_ptr<State> state);
+    void setState(State* state);
 
     /**
      * Queues an event for processing.
-     * @param event The event to be queued.
+     * @param event The event and its payload.
      */
-    void queueEvent(Event event);
+    void queueEvent(const EventRecord& event);
 
     /**
      * Processes events from the event queue.
@@ -125,14 +272,51 @@ public:
     void processEvents();
 
     /**
-     * Triggers a timeout event.
+     * Processes a batch of queued events on an executor thread.
+     */
+    void run() override;
+
+    /**
+     * Dispatches one event to the current state and performs the resulting transition.
+     * @param event The event to dispatch.
+     */
+    void dispatch(const EventRecord& event);
+
+    /**
+     * Waits until every queued event has been processed.
+     */
+    void waitUntilIdle();
+
+    /**
+     * Triggers a timeout event for the pending timer.
      */
     void timeout();
 
+    /**
+     * Called by the timer service when a timer of this context expires.
+     * @param generation The generation the timer was started under.
+     */
+    void timerExpired(uint64_t generation);
+
     /**
      * Triggers a pedestrian waiting event.
+     * @param crosswalk The crosswalk whose button was pressed.
+     */
+    void pedestrianWaiting(uint8_t crosswalk = 0);
+
+    /**
+     * Triggers a vehicle sensor event.
+     * @param approach The approach the sensor watches.
+     * @param count The number of vehicles detected since the last report.
      */
-    void pedestrianWaiting();
+    void vehicleDetected(uint8_t approach, uint16_t count);
+
+    /**
+     * Triggers an emergency preemption event.
+     * @param approach The approach the emergency vehicle is coming from.
+     * @param active True when preemption starts, false when it is released.
+     */
+    void emergencyPreemption(uint8_t approach, bool active);
 
     /**
      * Sets the pedestrian waiting flag.
@@ -146,29 +330,118 @@ public:
      */
     bool getIsPedestrianWaiting() const;
 
+    /**
+     * Sets the number of flashes left in the PedestriansFlash state.
+     * @param value The number of flashes left.
+     */
+    void setFlashCounter(int value);
+
+    /**
+     * Gets the number of flashes left in the PedestriansFlash state.
+     * @return The number of flashes left.
+     */
+    int getFlashCounter() const;
+
     /**
      * Signals vehicles with a specified signal.
      * @param signal The signal to be displayed to vehicles.
      */
-    void signalVehicles(const std::string& signal);
+    void signalVehicles(const char* signal);
 
     /**
      * Signals pedestrians with a specified signal.
      * @param signal The signal to be displayed to pedestrians.
      */
-    void signalPedestrians(const std::string& signal);
+    void signalPedestrians(const char* signal);
 
     /**
      * Starts a timer that triggers a timeout event after a specified number of seconds.
+     * Any timer already pending for this context is cancelled first.
      * @param seconds The duration in seconds for the timer.
+     * @return The handle of the new timer.
+     */
+    TimerId startTimer(int seconds);
+
+    /**
+     * Starts a timer that triggers a timeout event after a delay.
+     * Any timer already pending for this context is cancelled first.
+     * @param delay The time until the timer expires.
+     * @return The handle of the new timer.
+     */
+    TimerId startTimer(std::chrono::milliseconds delay);
+
+    /**
+     * Sets the phase lengths used by the states' entry actions. Takes effect from the next
+     * timer a state starts.
+     * @param timing The phase lengths.
+     */
+    void setTiming(const TimingConfig& timing);
+
+    /**
+     * Gets the phase lengths used by the states' entry actions.
+     * @return The phase lengths.
+     */
+    const TimingConfig& getTiming() const;
+
+    /**
+     * Cancels the pending timer, if any. A timeout of the cancelled timer that is already
+     * queued is discarded when it is processed.
+     */
+    void cancelTimer();
+
+    /**
+     * Get the number of timeouts discarded because their timer had been cancelled or replaced.
+     * @return The number of stale timeouts.
+     */
+    uint64_t getStaleTimeoutCount() const;
+
+    /**
+     * Get the number of events coalesced into an identical event queued just before them.
+     * @return The number of coalesced events.
+     */
+    uint64_t getCoalescedEventCount() const;
+
+    /**
+     * Checkpoints the context into a slot of a file after every event and state change.
+     * Attach before the context starts processing events. The file must outlive the context.
+     * @param file The checkpoint file.
+     * @param slot The context's slot in the file.
+     */
+    void attachCheckpoint(CheckpointFile& file, size_t slot);
+
+    /**
+     * Resumes the state saved in the context's checkpoint slot: the state, pedestrian waiting
+     * flag and flash counter are restored and the pending timer is restarted with the time it
+     * had left, less the time since the checkpoint. Entry actions are not run again.
+     * @return False if there is no checkpoint file or the slot holds no state.
+     */
+    bool restoreCheckpoint();
+
+    /**
+     * Copies the context's counters and histograms without stopping event processing.
+     * Values recorded while the copy is taken may be partially included.
+     * @return The metrics.
      */
-    void startTimer(int seconds);
+    ContextMetrics getMetrics() const;
 
     /**
-     * Get the name of the current state.
+     * Get the name of the current state. Does not lock.
      * @return The name of the current state as a string, or "NO_STATE" if no state is set.
      */
     std::string getCurrentStateName() const;
+
+    /**
+     * Get the current state. Wait-free, so monitoring threads can poll it without contending
+     * with event processing.
+     * @return The identifier of the current state.
+     */
+    StateId getCurrentStateId() const;
+
+    /**
+     * Get the current state together with its transition sequence number. Wait-free.
+     * @return The current state and the number of states entered so far.
+     */
+    StateSnapshot getStateSnapshot() const;
 };
 
 /**
@@ -176,11 +449,17 @@ public:
  */
 class VehiclesGreen : public State {
 public:
-    std::string getName() const override;
+    /**
+     * @return The shared instance of the state.
+     */
+    static VehiclesGreen& instance();
+
+    const char* getName() const override;
+    StateId getId() const override;
     void entry(Context* context) override;
     void exit(Context*) override;
-    std::shared_ptr<State> timeout(Context* context) override;
-    std::shared_ptr<State> pedestrianWaiting(Context*) override;
+    State* timeout(Context* context) override;
+    State* pedestrianWaiting(Context*) override;
 };
 
 /**
@@ -188,11 +467,17 @@ public:
  */
 class VehiclesYellow : public State {
 public:
-    std::string getName() const override;
+    /**
+     * @return The shared instance of the state.
+     */
+    static VehiclesYellow& instance();
+
+    const char* getName() const override;
+    StateId getId() const override;
     void entry(Context* context) override;
     void exit(Context*) override;
-    std::shared_ptr<State> timeout(Context*) override;
-    std::shared_ptr<State> pedestrianWaiting(Context*) override;
+    State* timeout(Context*) override;
+    State* pedestrianWaiting(Context*) override;
 };
 
 /**
@@ -200,11 +485,17 @@ public:
  */
 class PedestriansWalk : public State {
 public:
-    std::string getName() const override;
+    /**
+     * @return The shared instance of the state.
+     */
+    static PedestriansWalk& instance();
+
+    const char* getName() const override;
+    StateId getId() const override;
     void entry(Context* context) override;
     void exit(Context*) override;
-    std::shared_ptr<State> timeout(Context*) override;
-    std::shared_ptr<State> pedestrianWaiting(Context*) override;
+    State* timeout(Context*) override;
+    State* pedestrianWaiting(Context*) override;
 };
 
 /**
@@ -212,20 +503,27 @@ public:
  */
 class PedestriansFlash : public State {
 private:
-    int flashCounter;
     void handleFlash(Context* context);
 
 public:
     /**
-     * Constructs a PedestriansFlash state object.
+     * @return The shared instance of the state.
      */
-    PedestriansFlash();
+    static PedestriansFlash& instance();
 
-    std::string getName() const override;
+    const char* getName() const override;
+    StateId getId() const override;
     void entry(Context* context) override;
     void exit(Context*) override;
-    std::shared_ptr<State> timeout(Context* context) override;
-    std::shared_ptr<State> pedestrianWaiting(Context*) override;
+    State* timeout(Context* context) override;
+    State* pedestrianWaiting(Context*) override;
 };
 
+/**
+ * Get the state with an identifier.
+ * @param id The state identifier.
+ * @return The shared instance of the state, or nullptr for StateId::NONE or an unknown identifier.
+ */
+State* stateForId(StateId id);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,100 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light metrics
+*/
+
+#include "metrics.h"
+
+/**
+ * @return The mean of the values recorded, 0 if there are none.
+ */
+double HistogramSnapshot::mean() const {
+    return count ? static_cast<double>(sum) / count : 0.0;
+}
+
+/**
+ * Estimate a percentile from the buckets.
+ * @param fraction The fraction of values at or below the result, e.g. 0.99.
+ * @return The upper bound of the bucket holding that fraction of the values, capped at max.
+ */
+uint64_t HistogramSnapshot::percentile(double fraction) const {
+    uint64_t target = static_cast<uint64_t>(fraction * count);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen > target) {
+            if (i + 1 == BUCKETS) return max;
+            uint64_t upper = Histogram::bucketLowerBound(i + 1) - 1;
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+/**
+ * Constructs an empty Histogram.
+ */
+Histogram::Histogram() : count(0), sum(0), max(0) {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Find the bucket of a value: the position of its highest set bit picks the power of two, and
+ * the SUB_BITS bits below it pick the bucket within it.
+ * @param value A value.
+ * @return The index of the bucket the value falls into.
+ */
+size_t Histogram::bucketIndex(uint64_t value) {
+    if (value < (uint64_t(1) << SUB_BITS)) {
+        return static_cast<size_t>(value);
+    }
+    if (value >= (uint64_t(1) << MAX_BITS)) {
+        return BUCKETS - 1;
+    }
+    unsigned exponent = 63 - __builtin_clzll(value);
+    size_t sub = static_cast<size_t>(value >> (exponent - SUB_BITS)) & ((1u << SUB_BITS) - 1);
+    return ((exponent - SUB_BITS + 1) << SUB_BITS) + sub;
+}
+
+/**
+ * @param index A bucket index.
+ * @return The smallest value that falls into the bucket.
+ */
+uint64_t Histogram::bucketLowerBound(size_t index) {
+    if (index < (size_t(1) << SUB_BITS)) {
+        return index;
+    }
+    unsigned exponent = static_cast<unsigned>(index >> SUB_BITS) + SUB_BITS - 1;
+    uint64_t sub = index & ((size_t(1) << SUB_BITS) - 1);
+    return (uint64_t(1) << exponent) | (sub << (exponent - SUB_BITS));
+}
+
+/**
+ * Record a value.
+ * @param value The value.
+ */
+void Histogram::record(uint64_t value) {
+    buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t largest = max.load(std::memory_order_relaxed);
+    while (value > largest && !max.compare_exchange_weak(largest, value, std::memory_order_relaxed)) {
+    }
+}
+
+/**
+ * Copy the histogram. Values recorded concurrently may be partially included.
+ * @return The copy.
+ */
+HistogramSnapshot Histogram::snapshot() const {
+    HistogramSnapshot copy;
+    copy.count = count.load(std::memory_order_relaxed);
+    copy.sum = sum.load(std::memory_order_relaxed);
+    copy.max = max.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < BUCKETS; i++) {
+        copy.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+    return copy;
+}
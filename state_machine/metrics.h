@@ -0,0 +1,92 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light metrics
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A copy of a Histogram taken at one point in time.
+ */
+struct HistogramSnapshot {
+    static const size_t BUCKETS = 92; // Must match Histogram::BUCKETS
+
+    uint64_t count;            // Values recorded
+    uint64_t sum;              // Sum of the values recorded
+    uint64_t max;              // Largest value recorded
+    uint64_t buckets[BUCKETS]; // Values recorded per bucket
+
+    /**
+     * @return The mean of the values recorded, 0 if there are none.
+     */
+    double mean() const;
+
+    /**
+     * Estimates a percentile from the buckets.
+     * @param fraction The fraction of values at or below the result, e.g. 0.99.
+     * @return The upper bound of the bucket holding that fraction of the values, capped at max.
+     */
+    uint64_t percentile(double fraction) const;
+};
+
+/**
+ * Log-linear histogram of non-negative integers, safe to record into from any thread and to
+ * snapshot while it is being recorded into.
+ *
+ * Values below 4 get a bucket each; above that, every power of two is split into 4 equal
+ * buckets, so a bucket is never wider than a quarter of its lower bound. Values of 2^24 and
+ * above share the last bucket. Recording is a few relaxed atomic increments and never blocks.
+ */
+class Histogram {
+public:
+    static const unsigned SUB_BITS = 2;     // log2 of the buckets per power of two
+    static const unsigned MAX_BITS = 24;    // Values from 2^MAX_BITS go to the last bucket
+    static const size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) << SUB_BITS;
+
+    static_assert(BUCKETS == HistogramSnapshot::BUCKETS, "snapshot bucket count out of date");
+
+    /**
+     * Constructs an empty Histogram.
+     */
+    Histogram();
+
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    /**
+     * Records a value.
+     * @param value The value.
+     */
+    void record(uint64_t value);
+
+    /**
+     * Copies the histogram. Values recorded concurrently may be partially included.
+     * @return The copy.
+     */
+    HistogramSnapshot snapshot() const;
+
+    /**
+     * @param index A bucket index.
+     * @return The smallest value that falls into the bucket.
+     */
+    static uint64_t bucketLowerBound(size_t index);
+
+    /**
+     * @param value A value.
+     * @return The index of the bucket the value falls into.
+     */
+    static size_t bucketIndex(uint64_t value);
+
+private:
+    std::atomic<uint64_t> buckets[BUCKETS]; // Values recorded per bucket
+    std::atomic<uint64_t> count;            // Values recorded
+    std::atomic<uint64_t> sum;              // Sum of the values recorded
+    std::atomic<uint64_t> max;              // Largest value recorded
+};
+
+#endif
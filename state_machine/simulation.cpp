@@ -0,0 +1,265 @@
+/*
+Author: Varrahan Uthayan
+Title: Monte Carlo traffic light simulation
+*/
+
+#include "main.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Parameters of a simulation run.
+ */
+struct SimulationOptions {
+    size_t intersections = 100; // Intersections simulated per timing configuration
+    double hours = 1.0;         // Simulated time per intersection
+    double rate = 2.0;          // Mean pedestrian arrivals per minute at each intersection
+    unsigned threads = 0;       // Worker threads, 0 for one per core
+    uint64_t seed = 1;          // Base seed of the random number generators
+    bool sweep = false;         // Sweep a grid of timings instead of running the defaults only
+};
+
+/**
+ * Aggregated outcome of every intersection run with one timing configuration. Workers record
+ * into it concurrently; the histograms and counters are lock-free.
+ */
+struct ConfigResult {
+    TimingConfig timing;                // The timing configuration
+    Histogram waitMs;                   // Wait of every pedestrian from arrival to WALK
+    Histogram servedPerHour;            // Pedestrians served per hour by each intersection
+    std::atomic<uint64_t> greenMs{0};   // Completed green time summed over the intersections
+    std::atomic<uint64_t> simulatedMs{0}; // Simulated time summed over the intersections
+};
+
+/**
+ * Derive the seed of one simulated intersection (splitmix64 of the base seed and the index), so
+ * neighbouring indices get unrelated generator streams.
+ * @param base The base seed.
+ * @param index The intersection's job index.
+ * @return The seed.
+ */
+uint64_t mixSeed(uint64_t base, uint64_t index) {
+    uint64_t z = base + (index + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Simulates one intersection. Pedestrians arrive as a Poisson process; one arriving during WALK
+ * crosses at once, any other presses the button and waits for the next WALK. The clock jumps
+ * from event to event, so an hour of traffic takes microseconds.
+ * @param result The configuration's result to record into.
+ * @param options The simulation parameters.
+ * @param seed Seed of this intersection's random number generator.
+ */
+void simulateIntersection(ConfigResult& result, const SimulationOptions& options, uint64_t seed) {
+    SimulatedClock clock;
+    InlineExecutor executor;
+    Context context(clock, executor);
+    context.setTiming(result.timing);
+    context.setState(&VehiclesGreen::instance());
+
+    std::mt19937_64 random(seed);
+    std::exponential_distribution<double> gapMs(options.rate / 60000.0);
+    const uint64_t start = clock.now();
+    const uint64_t end = start + static_cast<uint64_t>(options.hours * 3600000.0);
+    uint64_t nextArrival = start + static_cast<uint64_t>(gapMs(random));
+    std::vector<uint64_t> waiting;
+    uint64_t served = 0;
+
+    for (;;) {
+        uint64_t deadline;
+        bool pending = clock.nextDeadline(deadline);
+        if (pending && deadline <= nextArrival && deadline <= end) {
+            clock.step();
+            if (context.getCurrentStateId() == StateId::PEDESTRIANS_WALK && !waiting.empty()) {
+                uint64_t now = clock.now();
+                for (uint64_t arrival : waiting) {
+                    result.waitMs.record(now - arrival);
+                }
+                served += waiting.size();
+                waiting.clear();
+            }
+        } else if (nextArrival <= end) {
+            clock.advance(std::chrono::milliseconds(nextArrival - clock.now()));
+            if (context.getCurrentStateId() == StateId::PEDESTRIANS_WALK) {
+                result.waitMs.record(0);
+                served++;
+            } else {
+                waiting.push_back(nextArrival);
+                context.pedestrianWaiting();
+            }
+            nextArrival += static_cast<uint64_t>(gapMs(random));
+        } else {
+            break;
+        }
+    }
+
+    // Pedestrians still waiting at the end are left out rather than given a truncated wait
+    result.servedPerHour.record(static_cast<uint64_t>(served / options.hours + 0.5));
+    result.greenMs.fetch_add(context.getMetrics().dwellMs[static_cast<size_t>(StateId::VEHICLES_GREEN)].sum,
+                             std::memory_order_relaxed);
+    result.simulatedMs.fetch_add(end - start, std::memory_order_relaxed);
+}
+
+/**
+ * Builds the timing configurations to simulate.
+ * @param sweep True for a grid of green, walk and flash settings, false for the defaults only.
+ * @return The configurations.
+ */
+std::vector<TimingConfig> buildConfigs(bool sweep) {
+    std::vector<TimingConfig> configs;
+    if (!sweep) {
+        configs.push_back(TimingConfig());
+        return configs;
+    }
+    for (int green = 5; green <= 60; green += 5) {
+        for (int yellow = 3; yellow <= 5; yellow++) {
+            for (int walk = 5; walk <= 30; walk += 5) {
+                for (int flashes : {3, 5, 7}) {
+                    TimingConfig timing;
+                    timing.green = std::chrono::seconds(green);
+                    timing.yellow = std::chrono::seconds(yellow);
+                    timing.walk = std::chrono::seconds(walk);
+                    timing.flashes = flashes;
+                    configs.push_back(timing);
+                }
+            }
+        }
+    }
+    return configs;
+}
+
+/**
+ * Runs every (configuration, intersection) pair on a pool of worker threads. Workers take the
+ * next pair from a shared counter, and each pair seeds its own generator from the base seed and
+ * its index, so results do not depend on the number of threads or the order pairs are run in.
+ * @param results The configurations to run, receiving their results.
+ * @param count The number of configurations.
+ * @param options The simulation parameters.
+ */
+void runSimulations(ConfigResult* results, size_t count, const SimulationOptions& options) {
+    const size_t jobs = count * options.intersections;
+    unsigned threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+    threads = threads ? threads : 1;
+    std::atomic<size_t> nextJob{0};
+    auto worker = [&]() {
+        for (size_t job = nextJob.fetch_add(1, std::memory_order_relaxed); job < jobs;
+             job = nextJob.fetch_add(1, std::memory_order_relaxed)) {
+            simulateIntersection(results[job / options.intersections], options, mixSeed(options.seed, job));
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+}
+
+/**
+ * Writes one configuration's result as a JSON object.
+ * @param out The stream to write to.
+ * @param result The result.
+ */
+void writeJson(std::ostream& out, const ConfigResult& result) {
+    HistogramSnapshot wait = result.waitMs.snapshot();
+    HistogramSnapshot served = result.servedPerHour.snapshot();
+    uint64_t simulated = result.simulatedMs.load(std::memory_order_relaxed);
+    out << "{\"green_ms\": " << result.timing.green.count() << ", \"yellow_ms\": " << result.timing.yellow.count()
+        << ", \"walk_ms\": " << result.timing.walk.count() << ", \"flash_ms\": " << result.timing.flash.count()
+        << ", \"flashes\": " << result.timing.flashes << ", \"pedestrians\": " << wait.count
+        << ", \"wait_mean_ms\": " << wait.mean() << ", \"wait_p50_ms\": " << wait.percentile(0.5)
+        << ", \"wait_p90_ms\": " << wait.percentile(0.9) << ", \"wait_p99_ms\": " << wait.percentile(0.99)
+        << ", \"wait_max_ms\": " << wait.max << ", \"served_per_hour_mean\": " << served.mean()
+        << ", \"served_per_hour_p10\": " << served.percentile(0.1) << ", \"served_per_hour_p90\": " << served.percentile(0.9)
+        << ", \"green_share\": " << (simulated ? double(result.greenMs.load(std::memory_order_relaxed)) / simulated : 0.0)
+        << "}";
+}
+
+/**
+ * Parses the simulation options from the command line.
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @param options The options to fill in.
+ * @return True if all options were recognized, false otherwise.
+ */
+bool parseOptions(int argc, char* argv[], SimulationOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--sweep") {
+            options.sweep = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        std::string value = argv[++i];
+        if (option == "--intersections") {
+            options.intersections = std::stoul(value);
+        } else if (option == "--hours") {
+            options.hours = std::stod(value);
+        } else if (option == "--rate") {
+            options.rate = std::stod(value);
+        } else if (option == "--threads") {
+            options.threads = std::stoul(value);
+        } else if (option == "--seed") {
+            options.seed = std::stoull(value);
+        } else {
+            return false;
+        }
+    }
+    return options.intersections > 0 && options.hours > 0 && options.rate > 0;
+}
+
+/**
+ * Simulates intersections under one or many timing configurations and writes the wait-time and
+ * throughput distributions of each to stdout as JSON.
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @return Exit status code.
+ */
+int main(int argc, char* argv[]) {
+    SimulationOptions options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            std::cerr << "Usage: " << argv[0] << " [--intersections <n>] [--hours <h>] [--rate <per minute>]"
+                      << " [--threads <n>] [--seed <n>] [--sweep]" << std::endl;
+            return 1;
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Invalid option value" << std::endl;
+        return 1;
+    }
+    Logger::instance().setEnabled(false);
+
+    std::vector<TimingConfig> configs = buildConfigs(options.sweep);
+    std::unique_ptr<ConfigResult[]> results(new ConfigResult[configs.size()]);
+    for (size_t i = 0; i < configs.size(); i++) {
+        results[i].timing = configs[i];
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    runSimulations(results.get(), configs.size(), options);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::cout << "{\"results\": [\n";
+    for (size_t i = 0; i < configs.size(); i++) {
+        std::cout << "  ";
+        writeJson(std::cout, results[i]);
+        std::cout << (i + 1 < configs.size() ? ",\n" : "\n");
+    }
+    std::cout << "]}" << std::endl;
+    std::cerr << configs.size() << " configurations x " << options.intersections << " intersections in " << seconds
+              << " s (" << configs.size() / seconds << " configurations/s)" << std::endl;
+    return 0;
+}
@@ -12,7 +12,10 @@ Title: Assignment 3
 #include <thread>
 #include <chrono>
 #include <cassert>
+#include <cstdio>
 #include "main.h"
+#include "clock.h"
+#include "traffic_table.h"
 
 /**
  * Test function to simulate a normal traffic light cycle with pedestrian interaction.
@@ -21,19 +24,33 @@ Title: Assignment 3
  * the button while the vehicle light is green.
  * 
  * @param context The context object representing the current state of the traffic light system.
+ * @param clock The simulated clock driving the context.
  */
-void test_normal_cycle(Context& context) {
+void test_normal_cycle(Context& context, SimulatedClock& clock) {
     std::cout << "\n=== Testing Normal Cycle with Pedestrian ===\n";
 
-    context.setState(std::shared_ptr<State>(new VehiclesGreen()));
+    assert(context.getStateSnapshot().state == StateId::NONE);
+    context.setState(&VehiclesGreen::instance());
     assert(context.getCurrentStateName() == "VehiclesGreen");
+    assert(context.getStateSnapshot().sequence == 1);
 
-    std::this_thread::sleep_for(std::chrono::seconds(5));
+    clock.advance(std::chrono::seconds(5));
     std::cout << "\nSimulating pedestrian button press\n";
     context.pedestrianWaiting();
 
-    std::this_thread::sleep_for(std::chrono::seconds(35));
+    clock.advance(std::chrono::seconds(35));
     assert(context.getCurrentStateName() == "VehiclesGreen");
+    // Green -> Yellow -> Walk -> Flash -> Green
+    StateSnapshot snapshot = context.getStateSnapshot();
+    assert(snapshot.state == StateId::VEHICLES_GREEN && snapshot.sequence == 5);
+
+    ContextMetrics metrics = context.getMetrics();
+    // Pressed at 5 s, yellow at 10 s, walk at 13 s
+    assert(metrics.transitions == 4);
+    assert(metrics.pedestrianWaitMs.count == 1 && metrics.pedestrianWaitMs.max == 8000);
+    assert(metrics.dwellMs[static_cast<size_t>(StateId::VEHICLES_GREEN)].max == 10000);
+    assert(metrics.dwellMs[static_cast<size_t>(StateId::PEDESTRIANS_WALK)].max == 15000);
+    assert(metrics.timeInStateMs == 5000);
 }
 
 /**
@@ -43,20 +60,21 @@ void test_normal_cycle(Context& context) {
  * ensuring that each press is handled correctly within the cycle.
  * 
  * @param context The context object representing the current state of the traffic light system.
+ * @param clock The simulated clock driving the context.
  */
-void test_multiple_button_presses(Context& context) {
+void test_multiple_button_presses(Context& context, SimulatedClock& clock) {
     std::cout << "\n=== Testing Multiple Button Presses ===\n";
 
-    context.setState(std::shared_ptr<State>(new VehiclesGreen()));
+    context.setState(&VehiclesGreen::instance());
     assert(context.getCurrentStateName() == "VehiclesGreen");
 
     for (int i = 0; i < 3; i++) {
-        std::this_thread::sleep_for(std::chrono::seconds(2));
+        clock.advance(std::chrono::seconds(2));
         std::cout << "\nSimulating pedestrian button press #" << (i + 1) << "\n";
         context.pedestrianWaiting();
     }
 
-    std::this_thread::sleep_for(std::chrono::seconds(35));
+    clock.advance(std::chrono::seconds(35));
     assert(context.getCurrentStateName() == "VehiclesGreen");
 }
 
@@ -67,14 +85,15 @@ void test_multiple_button_presses(Context& context) {
  * presses the button.
  * 
  * @param context The context object representing the current state of the traffic light system.
+ * @param clock The simulated clock driving the context.
  */
-void test_no_pedestrian(Context& context) {
+void test_no_pedestrian(Context& context, SimulatedClock& clock) {
     std::cout << "\n=== Testing No Pedestrian Scenario ===\n";
 
-    context.setState(std::shared_ptr<State>(new VehiclesGreen()));
+    context.setState(&VehiclesGreen::instance());
     assert(context.getCurrentStateName() == "VehiclesGreen");
 
-    std::this_thread::sleep_for(std::chrono::seconds(15));
+    clock.advance(std::chrono::seconds(15));
     assert(context.getCurrentStateName() == "VehiclesGreen");
 }
 
@@ -85,25 +104,344 @@ void test_no_pedestrian(Context& context) {
  * light is already in the "WALK" state.
  * 
  * @param context The context object representing the current state of the traffic light system.
+ * @param clock The simulated clock driving the context.
  */
-void test_button_during_pedestrian_walk(Context& context) {
+void test_button_during_pedestrian_walk(Context& context, SimulatedClock& clock) {
     std::cout << "\n=== Testing Button Press During Walk Signal ===\n";
 
-    context.setState(std::shared_ptr<State>(new VehiclesGreen()));
+    context.setState(&VehiclesGreen::instance());
     assert(context.getCurrentStateName() == "VehiclesGreen");
 
-    std::this_thread::sleep_for(std::chrono::seconds(5));
+    clock.advance(std::chrono::seconds(5));
     std::cout << "\nSimulating first pedestrian button press\n";
     context.pedestrianWaiting();
 
-    std::this_thread::sleep_for(std::chrono::seconds(8));
+    clock.advance(std::chrono::seconds(8));
     std::cout << "\nSimulating second pedestrian button press during WALK\n";
     context.pedestrianWaiting();
 
-    std::this_thread::sleep_for(std::chrono::seconds(25));
+    clock.advance(std::chrono::seconds(25));
+    assert(context.getCurrentStateName() == "VehiclesGreen");
+}
+
+/**
+ * Test function to verify the ordering and cancellation of the timer wheel.
+ *
+ * This test schedules timers spanning several wheel levels, cancels one of them, and checks that
+ * the rest expire exactly at their deadlines and in deadline order.
+ */
+void test_timer_wheel() {
+    std::cout << "\n=== Testing Timer Wheel ===\n";
+
+    TimerWheel wheel;
+    std::vector<TimerExpiry> expired;
+    TimerId cancelled = wheel.schedule(3000, nullptr, 1);
+    wheel.schedule(15000, nullptr, 2);
+    wheel.schedule(1, nullptr, 3);
+    wheel.schedule(70000, nullptr, 4);
+    wheel.schedule(300, nullptr, 5);
+    assert(wheel.size() == 5);
+    bool removed = wheel.cancel(cancelled);
+    assert(removed);
+    removed = wheel.cancel(cancelled);
+    assert(!removed);
+
+    uint64_t deadline = 0;
+    const uint64_t expected[][2] = {{1, 3}, {300, 5}, {15000, 2}, {70000, 4}};
+    for (const auto& timer : expected) {
+        bool pending = wheel.nextDeadline(deadline);
+        assert(pending && deadline == timer[0]);
+        wheel.advanceTo(deadline - 1, expired);
+        assert(expired.empty());
+        wheel.advanceTo(deadline, expired);
+        assert(expired.size() == 1 && expired[0].tag == timer[1]);
+        expired.clear();
+    }
+    assert(wheel.size() == 0 && !wheel.nextDeadline(deadline));
+
+    // A timer under 256 ticks that wraps into the next level 0 revolution must not be skipped over
+    TimerWheel wrapped;
+    wrapped.advanceTo(0x1F0, expired);
+    wrapped.schedule(0x205, nullptr, 6);
+    wrapped.schedule(0x700, nullptr, 7);
+    wrapped.advanceTo(0x206, expired);
+    assert(expired.size() == 1 && expired[0].tag == 6);
+    expired.clear();
+    assert(wrapped.nextDeadline(deadline) && deadline == 0x700);
+    wrapped.advanceTo(0x700, expired);
+    assert(expired.size() == 1 && expired[0].tag == 7);
+    expired.clear();
+    assert(wrapped.size() == 0);
+}
+
+/**
+ * Test function to verify the histogram buckets and percentiles.
+ *
+ * This test checks that every bucket's lower bound maps back to that bucket and that a
+ * percentile lands in the bucket holding it.
+ */
+void test_histogram() {
+    std::cout << "\n=== Testing Histogram ===\n";
+
+    for (size_t i = 0; i < Histogram::BUCKETS; i++) {
+        assert(Histogram::bucketIndex(Histogram::bucketLowerBound(i)) == i);
+        assert(i == 0 || Histogram::bucketIndex(Histogram::bucketLowerBound(i) - 1) == i - 1);
+    }
+    assert(Histogram::bucketIndex(UINT64_MAX) == Histogram::BUCKETS - 1);
+
+    Histogram histogram;
+    for (uint64_t value = 1; value <= 1000; value++) {
+        histogram.record(value);
+    }
+    HistogramSnapshot snapshot = histogram.snapshot();
+    assert(snapshot.count == 1000 && snapshot.max == 1000 && snapshot.mean() == 500.5);
+    uint64_t p50 = snapshot.percentile(0.5);
+    assert(p50 >= 500 && p50 <= 500 * 5 / 4);
+    assert(snapshot.percentile(1.0) == 1000);
+}
+
+/**
+ * Test function to verify that a context resumes from its checkpoint after a restart.
+ *
+ * This test runs a context into the walk phase with its checkpoint attached, destroys it as a
+ * restart would, and checks that a new context on the same file resumes the walk phase and
+ * finishes it when the timer saved with it runs out.
+ */
+void test_checkpoint() {
+    std::cout << "\n=== Testing Checkpoint Restore ===\n";
+
+    const char* path = "/tmp/traffic_light_checkpoint_test.bin";
+    std::remove(path);
+    {
+        CheckpointFile file(path, 4);
+        SimulatedClock clock;
+        Context context(clock);
+        context.attachCheckpoint(file, 2);
+        context.setState(&VehiclesGreen::instance());
+        context.pedestrianWaiting();
+        clock.advance(std::chrono::seconds(14)); // Walk started at 13 s with a 15 s timer
+        assert(context.getCurrentStateName() == "PedestriansWalk");
+    }
+    Logger::instance().flush();
+
+    CheckpointFile file(path, 4);
+    CheckpointRecord record;
+    assert(!file.read(0, record));
+    SimulatedClock clock;
+    Context context(clock);
+    context.attachCheckpoint(file, 2);
+    bool restored = context.restoreCheckpoint();
+    assert(restored);
+    assert(context.getCurrentStateId() == StateId::PEDESTRIANS_WALK);
+
+    // The last checkpoint was written as the walk began; simulated time since then is not
+    // seen by the new clock, so the full 15 s remain
+    clock.advance(std::chrono::seconds(14));
+    assert(context.getCurrentStateName() == "PedestriansWalk");
+    clock.advance(std::chrono::seconds(1));
+    assert(context.getCurrentStateName() == "PedestriansFlash");
+    std::remove(path);
+}
+
+/**
+ * Test function to verify that timeouts of cancelled timers are discarded.
+ *
+ * This test delivers a timeout tagged with a generation that has since been cancelled and checks
+ * that it is counted as stale instead of driving a transition.
+ *
+ * @param context The context object representing the current state of the traffic light system.
+ * @param clock The simulated clock driving the context.
+ */
+void test_stale_timeout(Context& context, SimulatedClock& clock) {
+    std::cout << "\n=== Testing Stale Timeout ===\n";
+
+    context.setState(&VehiclesGreen::instance());
+    context.setState(&VehiclesGreen::instance());
+    context.timerExpired(2); // Generation of the first timer, cancelled by the second setState
+
+    clock.advance(std::chrono::milliseconds(0));
+    assert(context.getStaleTimeoutCount() == 1);
     assert(context.getCurrentStateName() == "VehiclesGreen");
 }
 
+/**
+ * Executor that holds the submitted mailbox until the test runs it.
+ */
+class ManualExecutor : public Executor {
+public:
+    Task* task = nullptr;
+
+    void submit(Task* submitted) override {
+        task = submitted;
+    }
+};
+
+/**
+ * Test function to verify that repeated button presses are coalesced.
+ *
+ * This test queues a burst of presses and a timeout while the mailbox is held back, then runs
+ * it once and checks that the presses behind the first are merged but the timeout is not, and
+ * that events carrying different payloads are merged only where their merge rule allows.
+ *
+ * @param clock The simulated clock driving the context.
+ */
+void test_coalescing(SimulatedClock& clock) {
+    std::cout << "\n=== Testing Event Coalescing ===\n";
+
+    ManualExecutor executor;
+    Context context(clock, executor);
+    context.setState(&VehiclesGreen::instance());
+    for (int i = 0; i < 5; i++) {
+        context.pedestrianWaiting();
+    }
+    context.timeout();
+    context.pedestrianWaiting();
+
+    assert(executor.task != nullptr);
+    executor.task->run();
+    assert(context.getCoalescedEventCount() == 4);
+    assert(context.getIsPedestrianWaiting());
+    assert(context.getCurrentStateName() == "VehiclesYellow");
+
+    // Presses of different crosswalks stay apart; sensor reports of one approach add up
+    context.pedestrianWaiting(1);
+    context.pedestrianWaiting(2);
+    context.vehicleDetected(1, 3);
+    context.vehicleDetected(1, 4);
+    context.vehicleDetected(2, 1);
+    executor.task->run();
+    assert(context.getCoalescedEventCount() == 5);
+    assert(context.getCurrentStateName() == "VehiclesYellow");
+
+    EventRecord sensor(VehicleSensorPayload{1, 3});
+    bool coalesced = coalesceEvents(sensor, VehicleSensorPayload{1, 4});
+    assert(coalesced);
+    VehicleSensorPayload merged;
+    bool isSensor = sensor.get(merged);
+    assert(isSensor && merged.approach == 1 && merged.count == 7);
+    coalesced = coalesceEvents(sensor, VehicleSensorPayload{2, 1});
+    assert(!coalesced);
+    coalesced = coalesceEvents(sensor, PedestrianButtonPayload{1});
+    assert(!coalesced);
+    PedestrianButtonPayload button;
+    bool isButton = sensor.get(button);
+    assert(!isButton);
+}
+
+/**
+ * Test function to run many intersections on a shared thread pool.
+ *
+ * This test drives a pedestrian cycle on every context at once and checks that each one moves
+ * through the cycle on schedule even though the contexts have no threads of their own.
+ *
+ * @param clock The simulated clock driving the contexts.
+ */
+void test_executor(SimulatedClock& clock) {
+    std::cout << "\n=== Testing Contexts on a Thread Pool ===\n";
+
+    ThreadPoolExecutor pool(4);
+    std::vector<std::unique_ptr<Context>> contexts;
+    for (int i = 0; i < 32; i++) {
+        contexts.emplace_back(new Context(clock, pool));
+        contexts.back()->setState(&VehiclesGreen::instance());
+        contexts.back()->pedestrianWaiting();
+    }
+
+    clock.advance(std::chrono::seconds(12));
+    for (auto& context : contexts) {
+        assert(context->getCurrentStateName() == "VehiclesYellow");
+    }
+    clock.advance(std::chrono::seconds(30));
+    for (auto& context : contexts) {
+        assert(context->getCurrentStateName() == "VehiclesGreen");
+    }
+}
+
+/**
+ * A transition table with a row hidden behind an unguarded row for the same state and event.
+ */
+struct UnreachableRowTable {
+    enum class State : uint8_t { A, B };
+    enum class Event : uint8_t { GO };
+    static constexpr size_t STATES = 2;
+    static constexpr size_t EVENTS = 1;
+    struct Data {};
+    static constexpr std::array<fsm::Transition<State, Event, Data>, 2> table = {{
+        {State::A, Event::GO, State::B, nullptr, nullptr},
+        {State::A, Event::GO, State::A, nullptr, nullptr},
+    }};
+};
+static_assert(fsm::validate<UnreachableRowTable>() == fsm::TableError::UNREACHABLE_ROW, "unreachable row not detected");
+static_assert(fsm::validate<TrafficLight>() == fsm::TableError::NONE, "traffic light table is invalid");
+
+/**
+ * Test function to verify the traffic light expressed as a transition table.
+ *
+ * This test drives the table through a full pedestrian cycle and checks the states, signals and
+ * requested timers against the behavior of the State classes.
+ */
+void test_transition_table() {
+    std::cout << "\n=== Testing Transition Table ===\n";
+
+    using S = TrafficLight::State;
+    using E = TrafficLight::Event;
+    TrafficLightMachine machine(S::VEHICLES_GREEN);
+    assert(machine.data().vehicles == TrafficLight::Signal::GREEN && machine.data().timerSeconds == 10);
+
+    bool handled = machine.dispatch(E::TIMEOUT);
+    assert(handled && machine.state() == S::VEHICLES_GREEN);
+    handled = machine.dispatch(E::PEDESTRIAN_BUTTON);
+    assert(handled && machine.data().pedestrianWaiting);
+    handled = machine.dispatch(E::TIMEOUT);
+    assert(handled && machine.state() == S::VEHICLES_YELLOW);
+    assert(machine.data().timerSeconds == 3);
+    handled = machine.dispatch(E::TIMEOUT);
+    assert(handled && machine.state() == S::PEDESTRIANS_WALK);
+    assert(!machine.data().pedestrianWaiting && machine.data().pedestrians == TrafficLight::Signal::WALK);
+    handled = machine.dispatch(E::TIMEOUT);
+    assert(handled && machine.state() == S::PEDESTRIANS_FLASH);
+    for (int i = 0; i < 6; i++) {
+        handled = machine.dispatch(E::TIMEOUT);
+        assert(handled && machine.state() == S::PEDESTRIANS_FLASH);
+    }
+    handled = machine.dispatch(E::TIMEOUT);
+    assert(handled && machine.state() == S::VEHICLES_GREEN);
+}
+
+/**
+ * Test function to verify that a context follows its timing configuration instead of the
+ * default phase lengths.
+ *
+ * @param context The context object representing the current state of the traffic light system.
+ * @param clock The simulated clock driving the context.
+ */
+void test_timing(Context& context, SimulatedClock& clock) {
+    std::cout << "\n=== Testing Timing Configuration ===\n";
+
+    TimingConfig timing;
+    timing.green = std::chrono::seconds(2);
+    timing.yellow = std::chrono::seconds(1);
+    timing.walk = std::chrono::seconds(3);
+    timing.flash = std::chrono::milliseconds(500);
+    timing.flashes = 2;
+    context.setTiming(timing);
+
+    context.setState(&VehiclesGreen::instance());
+    context.pedestrianWaiting();
+    clock.advance(std::chrono::milliseconds(1999));
+    assert(context.getCurrentStateId() == StateId::VEHICLES_GREEN);
+    clock.advance(std::chrono::milliseconds(1));
+    assert(context.getCurrentStateId() == StateId::VEHICLES_YELLOW);
+    clock.advance(std::chrono::seconds(1));
+    assert(context.getCurrentStateId() == StateId::PEDESTRIANS_WALK);
+    clock.advance(std::chrono::seconds(3));
+    assert(context.getCurrentStateId() == StateId::PEDESTRIANS_FLASH);
+    clock.advance(std::chrono::milliseconds(999));
+    assert(context.getCurrentStateId() == StateId::PEDESTRIANS_FLASH);
+    clock.advance(std::chrono::milliseconds(1));
+    assert(context.getCurrentStateId() == StateId::VEHICLES_GREEN);
+}
+
 /**
  * Main function to execute the traffic light state machine tests.
  * 
@@ -116,31 +454,66 @@ int main() {
     std::cout << "Starting Traffic Light State Machine Tests\n";
     std::cout << "==========================================\n";
 
+    test_timer_wheel();
+    test_histogram();
+    test_transition_table();
+
+    {
+        SimulatedClock clock;
+        test_executor(clock);
+    }
+    Logger::instance().flush();
+
+    {
+        SimulatedClock clock;
+        test_coalescing(clock);
+    }
+    Logger::instance().flush();
+
+    test_checkpoint();
+    Logger::instance().flush();
+
+    {
+        SimulatedClock clock;
+        Context context(clock);
+        test_stale_timeout(context, clock);
+    }
+    Logger::instance().flush();
+
+    {
+        SimulatedClock clock;
+        Context context(clock);
+        test_timing(context, clock);
+    }
+    Logger::instance().flush();
+
     {
-        Context context;
-        test_normal_cycle(context);
+        SimulatedClock clock;
+        Context context(clock);
+        test_normal_cycle(context, clock);
     }
-    std::cout << "\nPress Enter to continue to next test...";
-    std::cin.get();
+    Logger::instance().flush();
 
     {
-        Context context;
-        test_multiple_button_presses(context);
+        SimulatedClock clock;
+        Context context(clock);
+        test_multiple_button_presses(context, clock);
     }
-    std::cout << "\nPress Enter to continue to next test...";
-    std::cin.get();
+    Logger::instance().flush();
 
     {
-        Context context;
-        test_button_during_pedestrian_walk(context);
+        SimulatedClock clock;
+        Context context(clock);
+        test_button_during_pedestrian_walk(context, clock);
     }
-    std::cout << "\nPress Enter to continue to next test...";
-    std::cin.get();
+    Logger::instance().flush();
 
     {
-        Context context;
-        test_no_pedestrian(context);
+        SimulatedClock clock;
+        Context context(clock);
+        test_no_pedestrian(context, clock);
     }
+    Logger::instance().flush();
     std::cout << "\nAll tests completed successfully!\n";
     return 0;
 }
@@ -0,0 +1,294 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light timer wheel
+*/
+
+#include "timer_wheel.h"
+
+#include <utility>
+
+/**
+ * Constructs an empty TimerWheel positioned at tick 0.
+ */
+TimerWheel::TimerWheel() : freeList(NIL), current(0), count(0) {
+    for (int level = 0; level < LEVELS; level++) {
+        for (uint32_t slot = 0; slot < SLOTS; slot++) {
+            heads[level][slot] = NIL;
+        }
+        for (uint32_t word = 0; word < WORDS; word++) {
+            occupied[level][word] = 0;
+        }
+    }
+}
+
+/**
+ * Take a node from the free list, growing the pool when it is empty.
+ * @return The index of the node.
+ */
+uint32_t TimerWheel::allocate() {
+    if (freeList != NIL) {
+        uint32_t index = freeList;
+        freeList = nodes[index].next;
+        return index;
+    }
+    nodes.push_back(Node{0, nullptr, 0, NIL, NIL, 0, 0, 0, false});
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+/**
+ * Return a node to the free list and invalidate its handles.
+ * @param index The index of the node.
+ */
+void TimerWheel::release(uint32_t index) {
+    Node& node = nodes[index];
+    node.active = false;
+    node.generation++;
+    node.next = freeList;
+    freeList = index;
+}
+
+/**
+ * Link a node into the slot matching its distance from the current tick.
+ * @param index The index of the node.
+ */
+void TimerWheel::link(uint32_t index) {
+    Node& node = nodes[index];
+    uint64_t delta = node.deadline > current ? node.deadline - current : 0;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ull << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    // Deadlines beyond the top level are parked at its far edge and cascaded again later
+    uint64_t horizon = current + (1ull << (SLOT_BITS * LEVELS)) - 1;
+    uint64_t placed = node.deadline < horizon ? node.deadline : horizon;
+    uint32_t slot = static_cast<uint32_t>(placed >> (SLOT_BITS * level)) & SLOT_MASK;
+    node.level = static_cast<uint8_t>(level);
+    node.slot = static_cast<uint16_t>(slot);
+    node.prev = NIL;
+    node.next = heads[level][slot];
+    if (node.next != NIL) {
+        nodes[node.next].prev = index;
+    }
+    heads[level][slot] = index;
+    occupied[level][slot / 64] |= 1ull << (slot % 64);
+}
+
+/**
+ * Unlink a node from its slot.
+ * @param index The index of the node.
+ */
+void TimerWheel::unlink(uint32_t index) {
+    Node& node = nodes[index];
+    if (node.prev != NIL) {
+        nodes[node.prev].next = node.next;
+    } else {
+        heads[node.level][node.slot] = node.next;
+    }
+    if (node.next != NIL) {
+        nodes[node.next].prev = node.prev;
+    }
+    if (heads[node.level][node.slot] == NIL) {
+        occupied[node.level][node.slot / 64] &= ~(1ull << (node.slot % 64));
+    }
+}
+
+/**
+ * Schedule a timer.
+ * @param deadline The absolute tick at which the timer expires.
+ * @param target The context the timer belongs to.
+ * @param tag A value handed back when the timer expires.
+ * @return The handle of the new timer.
+ */
+TimerId TimerWheel::schedule(uint64_t deadline, Context* target, uint64_t tag) {
+    uint32_t index = allocate();
+    Node& node = nodes[index];
+    node.deadline = deadline > current ? deadline : current + 1;
+    node.target = target;
+    node.tag = tag;
+    node.active = true;
+    link(index);
+    count++;
+    return (static_cast<uint64_t>(node.generation) << 32) | (index + 1);
+}
+
+/**
+ * Cancel a timer.
+ * @param id The handle returned by schedule.
+ * @return True if the timer was pending and is now cancelled.
+ */
+bool TimerWheel::cancel(TimerId id) {
+    uint32_t index = static_cast<uint32_t>(id & 0xFFFFFFFF) - 1;
+    uint32_t generation = static_cast<uint32_t>(id >> 32);
+    if (id == 0 || index >= nodes.size()) return false;
+    Node& node = nodes[index];
+    if (!node.active || node.generation != generation) return false;
+    unlink(index);
+    release(index);
+    count--;
+    return true;
+}
+
+/**
+ * Move every timer of a higher-level slot down to the level matching its remaining time.
+ * @param level The level to cascade from.
+ * @param slot The slot to cascade.
+ */
+void TimerWheel::cascade(int level, uint32_t slot) {
+    uint32_t index = heads[level][slot];
+    heads[level][slot] = NIL;
+    occupied[level][slot / 64] &= ~(1ull << (slot % 64));
+    while (index != NIL) {
+        uint32_t next = nodes[index].next;
+        link(index);
+        index = next;
+    }
+}
+
+/**
+ * Collect the timers of a level 0 slot that have reached their deadline.
+ * @param slot The slot to expire.
+ * @param expired Output vector the expired timers are appended to.
+ */
+void TimerWheel::expire(uint32_t slot, std::vector<TimerExpiry>& expired) {
+    uint32_t index = heads[0][slot];
+    heads[0][slot] = NIL;
+    occupied[0][slot / 64] &= ~(1ull << (slot % 64));
+    // Collect in scheduling order; the slot list holds the newest timer first
+    size_t first = expired.size();
+    while (index != NIL) {
+        uint32_t next = nodes[index].next;
+        Node& node = nodes[index];
+        if (node.deadline <= current) {
+            expired.push_back(TimerExpiry{node.target, node.tag});
+            release(index);
+            count--;
+        } else {
+            link(index);
+        }
+        index = next;
+    }
+    for (size_t i = first, j = expired.size(); i + 1 < j; i++, j--) {
+        std::swap(expired[i], expired[j - 1]);
+    }
+}
+
+/**
+ * Find the first occupied slot of a level in the range [from, to).
+ * @param level The level to search.
+ * @param from The first slot to check.
+ * @param to One past the last slot to check.
+ * @return The slot index, or -1 if every slot in the range is empty.
+ */
+int TimerWheel::nextOccupied(int level, uint32_t from, uint32_t to) const {
+    while (from < to) {
+        uint32_t word = from / 64;
+        uint64_t bits = occupied[level][word] >> (from % 64);
+        if (bits != 0) {
+            uint32_t slot = from + static_cast<uint32_t>(__builtin_ctzll(bits));
+            return slot < to ? static_cast<int>(slot) : -1;
+        }
+        from = (word + 1) * 64;
+    }
+    return -1;
+}
+
+/**
+ * Find the earliest deadline held in one slot.
+ * @param level The level of the slot.
+ * @param slot The slot index.
+ * @return The earliest deadline in the slot.
+ */
+uint64_t TimerWheel::slotMinimum(int level, uint32_t slot) const {
+    uint64_t minimum = UINT64_MAX;
+    for (uint32_t index = heads[level][slot]; index != NIL; index = nodes[index].next) {
+        if (nodes[index].deadline < minimum) {
+            minimum = nodes[index].deadline;
+        }
+    }
+    return minimum;
+}
+
+/**
+ * Advance the wheel, jumping straight over empty slots.
+ * @param tick The tick to advance to.
+ * @param expired Output vector the expired timers are appended to.
+ */
+void TimerWheel::advanceTo(uint64_t tick, std::vector<TimerExpiry>& expired) {
+    while (current < tick) {
+        if (count == 0) {
+            current = tick;
+            return;
+        }
+        // Next occupied level 0 slot before the end of the current revolution
+        uint32_t position = static_cast<uint32_t>(current) & SLOT_MASK;
+        int slot = nextOccupied(0, position + 1, SLOTS);
+        uint64_t step;
+        if (slot >= 0) {
+            step = (current & ~static_cast<uint64_t>(SLOT_MASK)) + slot;
+        } else if (nextOccupied(0, 0, position + 1) >= 0) {
+            // Timers that wrapped into the next revolution sit at or before the position
+            step = (current | SLOT_MASK) + 1;
+        } else {
+            // Level 0 is empty: skip the windows whose level 1 slot is empty too, since wrapping
+            // into them cascades nothing
+            const uint64_t windowMask = (1ull << (2 * SLOT_BITS)) - 1;
+            uint32_t window = static_cast<uint32_t>(current >> SLOT_BITS) & SLOT_MASK;
+            int next = nextOccupied(1, window + 1, SLOTS);
+            step = next >= 0 ? (current & ~windowMask) + (static_cast<uint64_t>(next) << SLOT_BITS) : (current | windowMask) + 1;
+        }
+        if (step > tick) {
+            current = tick;
+            return;
+        }
+        current = step;
+        if ((step & SLOT_MASK) == 0) {
+            // Level 0 wrapped: pull the next window down from every level that wrapped with it
+            for (int level = 1; level < LEVELS; level++) {
+                uint32_t index = static_cast<uint32_t>(current >> (SLOT_BITS * level)) & SLOT_MASK;
+                cascade(level, index);
+                if (index != 0) break;
+            }
+        }
+        expire(static_cast<uint32_t>(current) & SLOT_MASK, expired);
+    }
+}
+
+/**
+ * Find the earliest pending deadline.
+ * @param deadline Receives the earliest deadline.
+ * @return True if a timer is pending.
+ */
+bool TimerWheel::nextDeadline(uint64_t& deadline) const {
+    if (count == 0) return false;
+    uint64_t earliest = UINT64_MAX;
+    for (int level = 0; level < LEVELS; level++) {
+        // Slots after the current position hold the nearest window of this level
+        uint32_t position = static_cast<uint32_t>(current >> (SLOT_BITS * level)) & SLOT_MASK;
+        int slot = nextOccupied(level, position + 1, SLOTS);
+        if (slot < 0) {
+            slot = nextOccupied(level, 0, position + 1);
+        }
+        if (slot >= 0) {
+            uint64_t minimum = slotMinimum(level, static_cast<uint32_t>(slot));
+            if (minimum < earliest) {
+                earliest = minimum;
+            }
+        }
+    }
+    deadline = earliest;
+    return true;
+}
+
+/**
+ * @return The current tick of the wheel.
+ */
+uint64_t TimerWheel::now() const {
+    return current;
+}
+
+/**
+ * @return The number of pending timers.
+ */
+size_t TimerWheel::size() const {
+    return count;
+}
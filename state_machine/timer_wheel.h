@@ -0,0 +1,122 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light timer wheel
+*/
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+class Context;
+
+/**
+ * Handle identifying a scheduled timer. Zero never identifies a timer.
+ */
+using TimerId = uint64_t;
+
+/**
+ * A timer that has reached its deadline.
+ */
+struct TimerExpiry {
+    Context* target; // Context the timer belongs to
+    uint64_t tag;    // Value supplied when the timer was scheduled
+};
+
+/**
+ * Hierarchical timing wheel with a 1 ms tick.
+ *
+ * Four levels of 256 slots cover deadlines up to 2^32 ticks ahead. Timers are kept in
+ * intrusive doubly-linked lists inside a node pool, so scheduling and cancelling are O(1).
+ * Timers in higher levels are cascaded down when the level below wraps around, and a
+ * per-level occupancy bitmap lets the wheel skip over empty slots when advancing.
+ * The wheel is not thread-safe; callers serialize access.
+ */
+class TimerWheel {
+public:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 8;
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+
+    /**
+     * Constructs an empty TimerWheel positioned at tick 0.
+     */
+    TimerWheel();
+
+    /**
+     * Schedules a timer. Deadlines that are not in the future expire on the next tick.
+     * @param deadline The absolute tick at which the timer expires.
+     * @param target The context the timer belongs to.
+     * @param tag A value handed back when the timer expires.
+     * @return The handle of the new timer.
+     */
+    TimerId schedule(uint64_t deadline, Context* target, uint64_t tag);
+
+    /**
+     * Cancels a timer.
+     * @param id The handle returned by schedule.
+     * @return True if the timer was pending and is now cancelled, false otherwise.
+     */
+    bool cancel(TimerId id);
+
+    /**
+     * Advances the wheel and collects every timer whose deadline has been reached, in deadline order.
+     * @param tick The tick to advance to.
+     * @param expired Output vector the expired timers are appended to.
+     */
+    void advanceTo(uint64_t tick, std::vector<TimerExpiry>& expired);
+
+    /**
+     * Finds the earliest pending deadline.
+     * @param deadline Receives the earliest deadline.
+     * @return True if a timer is pending, false if the wheel is empty.
+     */
+    bool nextDeadline(uint64_t& deadline) const;
+
+    /**
+     * @return The current tick of the wheel.
+     */
+    uint64_t now() const;
+
+    /**
+     * @return The number of pending timers.
+     */
+    size_t size() const;
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+    static constexpr uint32_t SLOT_MASK = SLOTS - 1;
+    static constexpr uint32_t WORDS = SLOTS / 64;
+
+    struct Node {
+        uint64_t deadline;   // Absolute expiry tick
+        Context* target;     // Context the timer belongs to
+        uint64_t tag;        // Value handed back on expiry
+        uint32_t prev;       // Previous node in the slot list, or NIL
+        uint32_t next;       // Next node in the slot list, or in the free list
+        uint32_t generation; // Incremented on release so stale handles are rejected
+        uint16_t slot;       // Slot the node is linked into
+        uint8_t level;       // Level the node is linked into
+        bool active;         // True while the timer is pending
+    };
+
+    std::vector<Node> nodes;                  // Node pool
+    uint32_t freeList;                        // Head of the list of unused nodes
+    uint32_t heads[LEVELS][SLOTS];            // Slot list heads
+    uint64_t occupied[LEVELS][WORDS];         // Bitmap of non-empty slots per level
+    uint64_t current;                         // Current tick
+    size_t count;                             // Number of pending timers
+
+    uint32_t allocate();
+    void release(uint32_t index);
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    void cascade(int level, uint32_t slot);
+    void expire(uint32_t slot, std::vector<TimerExpiry>& expired);
+    int nextOccupied(int level, uint32_t from, uint32_t to) const;
+    uint64_t slotMinimum(int level, uint32_t slot) const;
+};
+
+#endif
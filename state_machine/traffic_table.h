@@ -0,0 +1,90 @@
+/*
+Author: Varrahan Uthayan
+Title: Traffic light transition table
+*/
+
+#ifndef TRAFFIC_TABLE_H
+#define TRAFFIC_TABLE_H
+
+#include "fsm_table.h"
+
+/**
+ * The traffic light of main.cpp expressed as a transition table. Signals and timers are recorded
+ * in the extended state instead of being performed, so the caller decides how to drive the
+ * lights and which clock to start the requested timer on.
+ */
+struct TrafficLight {
+    enum class State : uint8_t { VEHICLES_GREEN, VEHICLES_YELLOW, PEDESTRIANS_WALK, PEDESTRIANS_FLASH };
+    enum class Event : uint8_t { TIMEOUT, PEDESTRIAN_BUTTON };
+    enum class Signal : uint8_t { GREEN, YELLOW, RED, WALK, DONT_WALK, BLANK };
+
+    static constexpr size_t STATES = 4;
+    static constexpr size_t EVENTS = 2;
+
+    /**
+     * Extended state of one intersection.
+     */
+    struct Data {
+        bool pedestrianWaiting = false;       // A pedestrian pressed the button
+        int flashCounter = 0;                 // Flashes left in PEDESTRIANS_FLASH
+        int timerSeconds = 0;                 // Duration of the timer the machine last asked for
+        Signal vehicles = Signal::RED;        // Current vehicle signal
+        Signal pedestrians = Signal::DONT_WALK; // Current pedestrian signal
+    };
+
+    using Row = fsm::Transition<State, Event, Data>;
+    using Action = void (*)(Data&);
+
+    static constexpr bool pedestrianWaiting(const Data& data) { return data.pedestrianWaiting; }
+    static constexpr bool lastFlash(const Data& data) { return data.flashCounter == 1; }
+
+    static constexpr void pressButton(Data& data) { data.pedestrianWaiting = true; }
+    static constexpr void restartGreen(Data& data) { data.timerSeconds = 10; }
+    static constexpr void flash(Data& data) {
+        data.flashCounter--;
+        data.pedestrians = (data.flashCounter & 1) == 0 ? Signal::DONT_WALK : Signal::BLANK;
+        data.timerSeconds = 1;
+    }
+
+    static constexpr void enterGreen(Data& data) {
+        data.vehicles = Signal::GREEN;
+        data.pedestrians = Signal::DONT_WALK;
+        data.timerSeconds = 10;
+    }
+    static constexpr void enterYellow(Data& data) {
+        data.vehicles = Signal::YELLOW;
+        data.pedestrians = Signal::DONT_WALK;
+        data.timerSeconds = 3;
+    }
+    static constexpr void enterWalk(Data& data) {
+        data.vehicles = Signal::RED;
+        data.pedestrians = Signal::WALK;
+        data.pedestrianWaiting = false;
+        data.timerSeconds = 15;
+    }
+    static constexpr void enterFlash(Data& data) {
+        data.flashCounter = 7;
+        data.pedestrians = Signal::BLANK;
+        data.timerSeconds = 1;
+    }
+
+    static constexpr std::array<Row, 10> table = {{
+        {State::VEHICLES_GREEN, Event::TIMEOUT, State::VEHICLES_YELLOW, pedestrianWaiting, nullptr},
+        {State::VEHICLES_GREEN, Event::TIMEOUT, State::VEHICLES_GREEN, nullptr, restartGreen},
+        {State::VEHICLES_GREEN, Event::PEDESTRIAN_BUTTON, State::VEHICLES_GREEN, nullptr, pressButton},
+        {State::VEHICLES_YELLOW, Event::TIMEOUT, State::PEDESTRIANS_WALK, nullptr, nullptr},
+        {State::VEHICLES_YELLOW, Event::PEDESTRIAN_BUTTON, State::VEHICLES_YELLOW, nullptr, pressButton},
+        {State::PEDESTRIANS_WALK, Event::TIMEOUT, State::PEDESTRIANS_FLASH, nullptr, nullptr},
+        {State::PEDESTRIANS_WALK, Event::PEDESTRIAN_BUTTON, State::PEDESTRIANS_WALK, nullptr, pressButton},
+        {State::PEDESTRIANS_FLASH, Event::TIMEOUT, State::VEHICLES_GREEN, lastFlash, nullptr},
+        {State::PEDESTRIANS_FLASH, Event::TIMEOUT, State::PEDESTRIANS_FLASH, nullptr, flash},
+        {State::PEDESTRIANS_FLASH, Event::PEDESTRIAN_BUTTON, State::PEDESTRIANS_FLASH, nullptr, pressButton},
+    }};
+
+    static constexpr std::array<Action, STATES> entry = {{enterGreen, enterYellow, enterWalk, enterFlash}};
+    static constexpr std::array<Action, STATES> exit = {{nullptr, nullptr, nullptr, nullptr}};
+};
+
+using TrafficLightMachine = fsm::StateMachine<TrafficLight>;
+
+#endif